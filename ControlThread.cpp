@@ -3,13 +3,23 @@
 #include <mutex>
 #include <thread>
 #include <condition_variable>
+#include <atomic>
+#include <vector>
 #include "mainwindow.h"
+#include "barrier.hpp"
+#include "scheduler.hpp"
 #include "ControlThread.hpp"
+#include "tree.hpp"
+#include "mesh.hpp"
 
 using namespace std;
 
-ControlThread::ControlThread(unsigned long tcks, MainWindow *pWind):
-    ticks(tcks), taskCount(0), beginnable(false), mainWindow(pWind)
+ControlThread::ControlThread(unsigned long tcks, MainWindow *pWind,
+	const uint64_t q):
+    ticks(tcks), quantum(q), blockedInTree(0), beginnable(false),
+    cheatLock(false), lateClaims(0), lateTicks(0), maxLateness(0),
+    mainWindow(pWind), timeWarp(nullptr), commitTrees(nullptr),
+    parkedTiles(0), inFlight(0), scheduler(nullptr), mesh(nullptr)
 {
     QObject::connect(this, SIGNAL(updateCycles()),
         pWind, SLOT(updateLCD()));
@@ -17,61 +27,186 @@ ControlThread::ControlThread(unsigned long tcks, MainWindow *pWind):
 
 void ControlThread::releaseToRun()
 {
-	unique_lock<mutex> lck(runLock);
-	taskCountLock.lock();
-	signedInCount++;
-	if (signedInCount >= taskCount) {
-		taskCountLock.unlock();
-		lck.unlock();
+	//tiles on the M:N scheduler arrive through their worker
+	if (TileScheduler::inFiber()) {
+		TileScheduler::yieldTick();
+		return;
+	}
+	uint32_t localSense;
+	if (tickBarrier.arrive(localSense)) {
 		run();
 		return;
 	}
-	taskCountLock.unlock();
-	go.wait(lck);
+	tickBarrier.wait(localSense);
+}
+
+//equivalent to count calls of releaseToRun, but we are not a
+//participant (and are not woken) on the quanta in between
+void ControlThread::sleepTicks(const uint64_t& count)
+{
+	if (count == 0) {
+		return;
+	}
+	if (count == 1) {
+		releaseToRun();
+		return;
+	}
+	if (TileScheduler::inFiber()) {
+		TileScheduler::sleepTicks(count);
+		return;
+	}
+	atomic<uint32_t> woken(0);
+	sleepLock.lock();
+	sleepers.push(make_pair(ticks + count * quantum, &woken));
+	sleepLock.unlock();
+	//leaving counts as our arrival for this tick
+	if (tickBarrier.removeParticipant()) {
+		run();
+	}
+	TickBarrier::park(woken);
 }
 
 void ControlThread::incrementTaskCount()
 {
-	unique_lock<mutex> lock(taskCountLock);
-	taskCount++;
+	tickBarrier.addParticipant();
 }
 
 void ControlThread::decrementTaskCount()
 {
-	unique_lock<mutex> lck(runLock);
-	unique_lock<mutex> lock(taskCountLock);
-	taskCount--;
-	taskCountLock.unlock();
-	runLock.unlock();
-	if (signedInCount >= taskCount) {
+	if (TileScheduler::inFiber()) {
+		return;
+	}
+	if (tickBarrier.removeParticipant()) {
 		run();
 	}
 }
 
 void ControlThread::incrementBlocks()
 {
-	unique_lock<mutex> lck(runLock);
-	unique_lock<mutex> lckBlock(blockLock);
-	blockedInTree++;
-	lckBlock.unlock();
+	blockedInTree.fetch_add(1, memory_order_relaxed);
+}
+
+//leaving counts as our arrival for this tick - a commit wakes us
+void ControlThread::parkTile(ParkedTile& parked)
+{
+	parkedTiles++;
+	if (TileScheduler::inFiber()) {
+		TileScheduler::parkFiber(parked);
+		return;
+	}
+	if (tickBarrier.removeParticipant()) {
+		run();
+	}
+	TickBarrier::park(parked.woken);
 }
 
+//only from a commit - the tile runs again next tick
+void ControlThread::wakeTile(ParkedTile& parked)
+{
+	parkedTiles--;
+	if (parked.fiber) {
+		scheduler->wakeFiber(parked.fiber, ticks + quantum);
+		return;
+	}
+	unique_lock<mutex> lck(sleepLock);
+	sleepers.push(make_pair(ticks + quantum, &parked.woken));
+}
+
+//tick epilogue - only ever run by the thread that completed the tick
 void ControlThread::run()
 {
-	unique_lock<mutex> lck(runLock);
-	unique_lock<mutex> lckBlock(blockLock);
-	if (blockedInTree > 0) {
-		cout << "On tick " << ticks << " total blocks ";
-		cout << blockedInTree << endl;
-		blockedInTree = 0;
-	}
-	lckBlock.unlock();
-	signedInCount = 0;
-	ticks++;
-	go.notify_all();
-	//update LCD display
-	++(mainWindow->currentCycles);
-	emit updateCycles();
+	vector<atomic<uint32_t> *> woken;
+	//with every tile parked in a tree, or asleep while the trees
+	//carry its packets, nobody arrives for the next tick - run the
+	//empty ticks here until a commit or a wake tick brings one back
+	do {
+		const uint32_t blocks = blockedInTree.exchange(0,
+			memory_order_relaxed);
+		if (blocks > 0) {
+			cout << "On tick " << ticks << " total blocks ";
+			cout << blocks << endl;
+		}
+		//every tile has posted its requests for this tick - settle
+		//them
+		if (commitTrees) {
+			for (auto tree: *commitTrees) {
+				tree->commit(ticks);
+			}
+		}
+		if (mesh) {
+			mesh->commit();
+		}
+		ticks += quantum;
+		//update LCD display
+		mainWindow->currentCycles += quantum;
+		wakeSleepers(woken);
+		emit updateCycles();
+	} while (woken.empty() && tickBarrier.getParticipants() == 0 &&
+		(parkedTiles.load() > 0 || inFlight.load() > 0));
+	tickBarrier.release();
+	//only now - a woken tile arriving before the release would be
+	//counted against the tick just finished
+	for (auto flag: woken) {
+		TickBarrier::unpark(*flag);
+	}
+}
+
+//rejoin tiles whose wake tick has come - if nobody is left awake, or
+//waiting on a tree, and the trees carry nothing, then jump straight to
+//the earliest wake tick
+void ControlThread::wakeSleepers(vector<atomic<uint32_t> *>& woken)
+{
+	unique_lock<mutex> lck(sleepLock);
+	if (sleepers.empty()) {
+		return;
+	}
+	if (tickBarrier.getParticipants() == 0 && parkedTiles.load() == 0 &&
+		inFlight.load() == 0 && sleepers.top().first > ticks) {
+		const uint64_t skipped = sleepers.top().first - ticks;
+		ticks += skipped;
+		mainWindow->currentCycles += skipped;
+	}
+	while (!sleepers.empty() && sleepers.top().first <= ticks) {
+		tickBarrier.addParticipant();
+		woken.push_back(sleepers.top().second);
+		sleepers.pop();
+	}
+}
+
+//a tile claimed a Mux buffer late ticks after it could have in
+//strict mode - it was freed by a tile that had not yet reached that
+//point in the quantum
+void ControlThread::recordLateness(const uint64_t& late)
+{
+	lateClaims.fetch_add(1, memory_order_relaxed);
+	lateTicks.fetch_add(late, memory_order_relaxed);
+	uint64_t seen = maxLateness.load(memory_order_relaxed);
+	while (late > seen &&
+		!maxLateness.compare_exchange_weak(seen, late,
+		memory_order_relaxed)) {}
+}
+
+//only late claims are counted. Claims made in a different order
+//inside one quantum, global memory seen in host rather than tick order,
+//and the knock on effects of either go uncounted - -u measures the
+//whole error against a strict run
+void ControlThread::reportQuantum() const
+{
+	if (quantum == 1) {
+		return;
+	}
+	cout << "Quantum of " << quantum << " ticks: " << ticks / quantum;
+	cout << " barrier passes for " << ticks << " ticks" << endl;
+	const uint64_t late = lateClaims.load();
+	cout << "Deviation from strict mode: " << late;
+	cout << " late Mux claims";
+	if (late > 0) {
+		cout << ", mean " << (double)lateTicks.load() / late;
+		cout << " ticks, max " << maxLateness.load() << " ticks";
+	}
+	cout << endl;
+	cout << "Not counted: claim order within a quantum, global memory";
+	cout << " seen in host order" << endl;
 }
 
 void ControlThread::waitForBegin()
@@ -90,10 +225,12 @@ void ControlThread::begin()
 
 bool ControlThread::tryCheatLock()
 {
-	return cheatLock.try_lock();
+	bool held = false;
+	return cheatLock.compare_exchange_strong(held, true,
+		std::memory_order_acquire);
 }
 
 void ControlThread::unlockCheatLock()
 {
-	cheatLock.unlock();
+	cheatLock.store(false, std::memory_order_release);
 }
@@ -3,11 +3,30 @@
 #include <mutex>
 #include <thread>
 #include <condition_variable>
+#include <atomic>
+#include <queue>
+#include <vector>
+#include <utility>
 #include "mainwindow.h"
+#include "barrier.hpp"
 
 #ifndef __CONTROLTHREAD_
 #define __CONTROLTHREAD_
 
+class TimeWarp;
+class Tree;
+class TileFiber;
+class TileScheduler;
+class Mesh;
+
+//a tile waiting on a Mux buffer - off the barrier until the commit
+//that hands it over wakes it
+class ParkedTile {
+public:
+	std::atomic<uint32_t> woken;
+	TileFiber *fiber;
+	ParkedTile(): woken(0), fiber(nullptr) {}
+};
 
 
 class ControlThread: public QObject {
@@ -18,25 +37,67 @@ signals:
 
 private:
 	uint64_t ticks;
-	volatile uint16_t taskCount;
-	volatile uint16_t signedInCount;
-	volatile uint16_t blockedInTree;
+	//ticks covered by one pass through the barrier - 1 is strict
+	const uint64_t quantum;
+	TickBarrier tickBarrier;
+	std::atomic<uint32_t> blockedInTree;
 	std::mutex runLock;
 	bool beginnable;
 	std::condition_variable go;
-	std::mutex taskCountLock;
-	std::mutex blockLock;
-	std::mutex cheatLock;
+	//a flag, not a mutex - a fiber can take it on one worker and be
+	//stolen by another before it lets go
+	std::atomic<bool> cheatLock;
+	//tiles parked until a future tick - earliest wake on top
+	std::mutex sleepLock;
+	std::priority_queue<std::pair<uint64_t, std::atomic<uint32_t> *>,
+		std::vector<std::pair<uint64_t, std::atomic<uint32_t> *>>,
+		std::greater<std::pair<uint64_t,
+		std::atomic<uint32_t> *>>> sleepers;
+	//Mux handoffs a tile saw later than strict mode would have
+	std::atomic<uint64_t> lateClaims;
+	std::atomic<uint64_t> lateTicks;
+	std::atomic<uint64_t> maxLateness;
 	MainWindow *mainWindow;
+	//optimistic execution - no barrier at all when set
+	TimeWarp *timeWarp;
+	//trees to commit at the end of every tick - strict mode only
+	std::vector<Tree *> *commitTrees;
+	//tiles parked in the trees, and where their fibers go on waking
+	std::atomic<uint32_t> parkedTiles;
+	//split transaction packets the commits are still carrying
+	std::atomic<uint32_t> inFlight;
+	TileScheduler *scheduler;
+	//tile to tile messages, routed at the end of every tick
+	Mesh *mesh;
 	void run();
+	void wakeSleepers(std::vector<std::atomic<uint32_t> *>& woken);
 
 public:
-	ControlThread(unsigned long count = 0, MainWindow *pWind = nullptr);
+	ControlThread(unsigned long count = 0, MainWindow *pWind = nullptr,
+		const uint64_t q = 1);
 	void incrementTaskCount();
 	void decrementTaskCount();
 	void incrementBlocks();
 	void begin();
 	void releaseToRun();
+	void sleepTicks(const uint64_t& count);
+	uint64_t getTicks() const { return ticks; }
+	uint64_t getQuantum() const { return quantum; }
+	TimeWarp* getWarp() const { return timeWarp; }
+	void setWarp(TimeWarp *warp) { timeWarp = warp; }
+	void setTwoPhase(std::vector<Tree *> *trees) { commitTrees = trees; }
+	bool isTwoPhase() const { return commitTrees != nullptr; }
+	void setScheduler(TileScheduler *s) { scheduler = s; }
+	void setMesh(Mesh *m) { mesh = m; }
+	void parkTile(ParkedTile& parked);
+	void wakeTile(ParkedTile& parked);
+	uint32_t getParked() const { return parkedTiles.load(); }
+	void packetSent() { inFlight.fetch_add(1, std::memory_order_relaxed); }
+	void packetLanded()
+		{ inFlight.fetch_sub(1, std::memory_order_relaxed); }
+	uint32_t getInFlight() const { return inFlight.load(); }
+	void recordLateness(const uint64_t& late);
+	void reportQuantum() const;
 	void waitForBegin();
 	bool tryCheatLock();
 	void unlockCheatLock();
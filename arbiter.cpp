@@ -0,0 +1,161 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "arbiter.hpp"
+
+using namespace std;
+
+Arbiter* Arbiter::create(const long policy, const uint64_t& leftTiles,
+	const uint64_t& rightTiles)
+{
+	switch (policy) {
+	case FIXED_LEFT:
+		return new FixedLeftArbiter();
+	case ROUND_ROBIN:
+		return new RoundRobinArbiter();
+	case OLDEST_FIRST:
+		return new OldestFirstArbiter();
+	case WEIGHTED_SUBTREE:
+		return new WeightedArbiter(leftTiles, rightTiles);
+	default:
+		cerr << "No arbitration policy " << policy << endl;
+		throw "Arbitration policy error";
+	}
+}
+
+const string Arbiter::name(const long policy)
+{
+	switch (policy) {
+	case FIXED_LEFT:
+		return string("fixed left");
+	case ROUND_ROBIN:
+		return string("round robin");
+	case OLDEST_FIRST:
+		return string("oldest first");
+	case WEIGHTED_SUBTREE:
+		return string("weighted by subtree");
+	default:
+		return string("unknown");
+	}
+}
+
+//the side that went pays for both - an idle side cannot bank more than
+//a round's credit, or it would get a burst of turns when it wakes
+void WeightedArbiter::granted(const bool& left)
+{
+	const int64_t round = leftWeight + rightWeight;
+	leftCredit += leftWeight;
+	rightCredit += rightWeight;
+	if (left) {
+		leftCredit -= round;
+	} else {
+		rightCredit -= round;
+	}
+	leftCredit = max(-round, min(round, leftCredit));
+	rightCredit = max(-round, min(round, rightCredit));
+}
+
+WaitHistogram::WaitHistogram(): buckets(EXACT + 64, 0), count(0), sum(0),
+	worst(0)
+{
+}
+
+uint64_t WaitHistogram::bucketOf(const uint64_t& trip)
+{
+	if (trip < EXACT) {
+		return trip;
+	}
+	uint64_t bucket = EXACT;
+	for (uint64_t high = trip / EXACT; high > 1; high >>= 1) {
+		bucket++;
+	}
+	return bucket;
+}
+
+//smallest trip that lands in bucket
+uint64_t WaitHistogram::floorOf(const uint64_t& bucket)
+{
+	if (bucket < EXACT) {
+		return bucket;
+	}
+	return EXACT << (bucket - EXACT);
+}
+
+void WaitHistogram::record(const uint64_t& trip)
+{
+	buckets[bucketOf(trip)]++;
+	count++;
+	sum += trip;
+	worst = max(worst, trip);
+}
+
+uint64_t WaitHistogram::percentile(const double& p) const
+{
+	if (count == 0) {
+		return 0;
+	}
+	const uint64_t rank = max((uint64_t)1, (uint64_t)ceil(p * count));
+	uint64_t seen = 0;
+	for (uint64_t i = 0; i < buckets.size(); i++) {
+		seen += buckets[i];
+		if (seen >= rank) {
+			return min(floorOf(i), worst);
+		}
+	}
+	return worst;
+}
+
+void WaitHistogram::merge(const WaitHistogram& other)
+{
+	for (uint64_t i = 0; i < buckets.size(); i++) {
+		buckets[i] += other.buckets[i];
+	}
+	count += other.count;
+	sum += other.sum;
+	worst = max(worst, other.worst);
+}
+
+//ticks a trip took over an idle tree's
+static uint64_t waitOf(const uint64_t& trip, const uint64_t& emptyTrip)
+{
+	return trip > emptyTrip ? trip - emptyTrip : 0;
+}
+
+//a line per tile, then everyone - Jain's index over the tiles' mean
+//waits is 1 when every tile waits the same
+void reportWaits(const long policy, const uint64_t& emptyTrip,
+	const vector<WaitHistogram *>& tiles)
+{
+	WaitHistogram all;
+	double meanSum = 0.0;
+	double meanSquares = 0.0;
+	uint64_t waiting = 0;
+	for (uint64_t i = 0; i < tiles.size(); i++) {
+		const WaitHistogram& tile = *tiles[i];
+		if (tile.getCount() == 0) {
+			continue;
+		}
+		const double mean = max(0.0, tile.mean() - emptyTrip);
+		cout << "Waits, tile " << i << ": " << tile.getCount();
+		cout << " packets, mean " << mean << ", median ";
+		cout << waitOf(tile.percentile(0.5), emptyTrip) << ", 99% ";
+		cout << waitOf(tile.percentile(0.99), emptyTrip) << ", worst ";
+		cout << waitOf(tile.getWorst(), emptyTrip) << " ticks" << endl;
+		all.merge(tile);
+		meanSum += mean;
+		meanSquares += mean * mean;
+		waiting++;
+	}
+	if (waiting == 0) {
+		return;
+	}
+	cout << "Waits, " << Arbiter::name(policy) << ": " << all.getCount();
+	cout << " packets, mean " << max(0.0, all.mean() - emptyTrip);
+	cout << ", 99% " << waitOf(all.percentile(0.99), emptyTrip);
+	cout << " ticks, worst " << waitOf(all.getWorst(), emptyTrip);
+	cout << ", fairness " << (meanSquares > 0.0 ?
+		meanSum * meanSum / (waiting * meanSquares) : 1.0) << endl;
+}
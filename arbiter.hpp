@@ -0,0 +1,94 @@
+//Mux arbitration policies and the waits they give tiles
+#include <cstdint>
+#include <vector>
+#include <string>
+#ifndef _ARBITER_CLASS_
+#define _ARBITER_CLASS_
+
+//who a Mux lets go first when both its buffers hold a packet
+enum ArbitrationPolicy { FIXED_LEFT, ROUND_ROBIN, OLDEST_FIRST,
+	WEIGHTED_SUBTREE };
+
+//one per Mux - asked only when both buffers are full, told about every
+//packet that leaves. Packets are known by the tick they entered the tree
+class Arbiter {
+public:
+	virtual ~Arbiter() {}
+	virtual bool leftFirst(const uint64_t& leftIssued,
+		const uint64_t& rightIssued) const = 0;
+	virtual void granted(const bool&) {}
+	static Arbiter* create(const long policy, const uint64_t& leftTiles,
+		const uint64_t& rightTiles);
+	static const std::string name(const long policy);
+};
+
+//the original tree - right only moves when left is empty
+class FixedLeftArbiter: public Arbiter {
+public:
+	bool leftFirst(const uint64_t&, const uint64_t&) const
+		{ return true; }
+};
+
+//whoever did not go last
+class RoundRobinArbiter: public Arbiter {
+private:
+	bool lastLeft;
+public:
+	RoundRobinArbiter(): lastLeft(false) {}
+	bool leftFirst(const uint64_t&, const uint64_t&) const
+		{ return !lastLeft; }
+	void granted(const bool& left) { lastLeft = left; }
+};
+
+//the packet that has been in the tree longest - left on a tie
+class OldestFirstArbiter: public Arbiter {
+public:
+	bool leftFirst(const uint64_t& leftIssued,
+		const uint64_t& rightIssued) const
+		{ return leftIssued <= rightIssued; }
+};
+
+//smooth weighted round robin - each side gets turns in proportion to
+//the tiles below it
+class WeightedArbiter: public Arbiter {
+private:
+	const int64_t leftWeight;
+	const int64_t rightWeight;
+	int64_t leftCredit;
+	int64_t rightCredit;
+public:
+	WeightedArbiter(const uint64_t& leftTiles, const uint64_t& rightTiles):
+		leftWeight(leftTiles), rightWeight(rightTiles), leftCredit(0),
+		rightCredit(0) {}
+	bool leftFirst(const uint64_t&, const uint64_t&) const
+		{ return leftCredit + leftWeight >= rightCredit + rightWeight; }
+	void granted(const bool& left);
+};
+
+//a tile's trips to DDR and back - exact to 1023 ticks, then by powers
+//of two
+class WaitHistogram {
+private:
+	static const uint64_t EXACT = 1024;
+	std::vector<uint64_t> buckets;
+	uint64_t count;
+	uint64_t sum;
+	uint64_t worst;
+	static uint64_t bucketOf(const uint64_t& trip);
+	static uint64_t floorOf(const uint64_t& bucket);
+
+public:
+	WaitHistogram();
+	void record(const uint64_t& trip);
+	uint64_t getCount() const { return count; }
+	double mean() const { return count ? (double)sum / count : 0.0; }
+	uint64_t percentile(const double& p) const;
+	uint64_t getWorst() const { return worst; }
+	void merge(const WaitHistogram& other);
+};
+
+//waits are what a trip took over emptyTrip, the trip through an idle tree
+void reportWaits(const long policy, const uint64_t& emptyTrip,
+	const std::vector<WaitHistogram *>& tiles);
+
+#endif
@@ -0,0 +1,127 @@
+#include <atomic>
+#include <thread>
+#include <climits>
+#include <cstdint>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "barrier.hpp"
+
+using namespace std;
+
+static const uint64_t PARTICIPANT = 1ULL << 32;
+static const uint64_t ARRIVALS_MASK = PARTICIPANT - 1;
+
+static void futexWait(atomic<uint32_t>* word, const uint32_t value)
+{
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(word),
+		FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+#else
+	if (word->load() == value) {
+		this_thread::yield();
+	}
+#endif
+}
+
+static void futexWakeAll(atomic<uint32_t>* word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(word),
+		FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+	(void)word;
+#endif
+}
+
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+TickBarrier::TickBarrier(const uint32_t spins):
+	state(0), sense(0), sleepers(0), spinLimit(spins)
+{}
+
+void TickBarrier::addParticipant()
+{
+	state.fetch_add(PARTICIPANT);
+}
+
+//returns true if the departure completed the tick - caller must
+//then run the epilogue and release
+bool TickBarrier::removeParticipant()
+{
+	const uint64_t now = state.fetch_sub(PARTICIPANT) - PARTICIPANT;
+	return (now & ARRIVALS_MASK) == (now >> 32);
+}
+
+//returns true if this was the last arrival
+bool TickBarrier::arrive(uint32_t& localSense)
+{
+	//read the sense before arriving - it cannot flip until we have
+	localSense = sense.load(memory_order_acquire);
+	const uint64_t now = state.fetch_add(1, memory_order_acq_rel) + 1;
+	return (now & ARRIVALS_MASK) == (now >> 32);
+}
+
+//spinning only pays if every participant can be on a core at once
+uint32_t TickBarrier::spinBudget() const
+{
+	static const uint32_t cores = thread::hardware_concurrency();
+	if (cores < 2 || getParticipants() > cores) {
+		return 0;
+	}
+	return spinLimit;
+}
+
+void TickBarrier::wait(const uint32_t& localSense)
+{
+	const uint32_t spins = spinBudget();
+	for (uint32_t i = 0; i < spins; i++) {
+		if (sense.load(memory_order_acquire) != localSense) {
+			return;
+		}
+		cpuRelax();
+	}
+	//seq_cst pairs with release(): either it sees us in sleepers
+	//or we see the flipped sense before we sleep
+	sleepers.fetch_add(1);
+	while (sense.load() == localSense) {
+		futexWait(&sense, localSense);
+	}
+	sleepers.fetch_sub(1);
+}
+
+//called by the last arrival once the tick epilogue is done
+void TickBarrier::release()
+{
+	state.fetch_and(~ARRIVALS_MASK);
+	sense.fetch_add(1);
+	if (sleepers.load() > 0) {
+		futexWakeAll(&sense);
+	}
+}
+
+uint32_t TickBarrier::getParticipants() const
+{
+	return state.load(memory_order_relaxed) >> 32;
+}
+
+//block until unpark() sets the flag
+void TickBarrier::park(atomic<uint32_t>& flag)
+{
+	while (flag.load() == 0) {
+		futexWait(&flag, 0);
+	}
+}
+
+void TickBarrier::unpark(atomic<uint32_t>& flag)
+{
+	flag.store(1);
+	futexWakeAll(&flag);
+}
@@ -0,0 +1,36 @@
+//Tick barrier - sense reversing, lock free on the fast path
+#include <atomic>
+#include <cstdint>
+
+#ifndef _BARRIER_CLASS_
+#define _BARRIER_CLASS_
+
+//spins before a waiter gives up and sleeps on the futex
+static const uint32_t BARRIER_SPINS = 4096;
+
+class TickBarrier {
+private:
+	//high 32 bits count participants, low 32 bits count arrivals
+	//- one word so arrivals and departures can never both
+	//complete the same tick
+	std::atomic<uint64_t> state;
+	//the sense word - flipped (incremented) once per tick and
+	//used as the futex word
+	std::atomic<uint32_t> sense;
+	std::atomic<uint32_t> sleepers;
+	const uint32_t spinLimit;
+	uint32_t spinBudget() const;
+
+public:
+	TickBarrier(const uint32_t spins = BARRIER_SPINS);
+	void addParticipant();
+	bool removeParticipant();
+	bool arrive(uint32_t& localSense);
+	void wait(const uint32_t& localSense);
+	void release();
+	uint32_t getParticipants() const;
+	static void park(std::atomic<uint32_t>& flag);
+	static void unpark(std::atomic<uint32_t>& flag);
+};
+
+#endif
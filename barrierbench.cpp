@@ -0,0 +1,149 @@
+//barrierbench - compare ticks per second of the tick barriers
+//build: g++ -std=c++11 -O2 -o barrierbench barrierbench.cpp barrier.cpp -lpthread
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "barrier.hpp"
+
+using namespace std;
+
+//mutex and condition variable tick, as ControlThread used to do it
+class LegacyBarrier {
+private:
+	uint64_t ticks;
+	volatile uint16_t taskCount;
+	volatile uint16_t signedInCount;
+	mutex runLock;
+	condition_variable go;
+	mutex taskCountLock;
+
+	void run()
+	{
+		unique_lock<mutex> lck(runLock);
+		signedInCount = 0;
+		ticks++;
+		go.notify_all();
+	}
+
+public:
+	LegacyBarrier(): ticks(0), taskCount(0), signedInCount(0) {}
+
+	void incrementTaskCount()
+	{
+		unique_lock<mutex> lock(taskCountLock);
+		taskCount++;
+	}
+
+	void decrementTaskCount()
+	{
+		unique_lock<mutex> lck(runLock);
+		unique_lock<mutex> lock(taskCountLock);
+		taskCount--;
+		taskCountLock.unlock();
+		runLock.unlock();
+		if (signedInCount >= taskCount) {
+			run();
+		}
+	}
+
+	void releaseToRun()
+	{
+		unique_lock<mutex> lck(runLock);
+		taskCountLock.lock();
+		signedInCount++;
+		if (signedInCount >= taskCount) {
+			taskCountLock.unlock();
+			lck.unlock();
+			run();
+			return;
+		}
+		taskCountLock.unlock();
+		go.wait(lck);
+	}
+
+	uint64_t getTicks() const { return ticks; }
+};
+
+//the same protocol on top of TickBarrier, as ControlThread now does it
+class SenseBarrier {
+private:
+	uint64_t ticks;
+	TickBarrier tickBarrier;
+
+	void run()
+	{
+		ticks++;
+		tickBarrier.release();
+	}
+
+public:
+	SenseBarrier(): ticks(0) {}
+
+	void incrementTaskCount() { tickBarrier.addParticipant(); }
+
+	void decrementTaskCount()
+	{
+		if (tickBarrier.removeParticipant()) {
+			run();
+		}
+	}
+
+	void releaseToRun()
+	{
+		uint32_t localSense;
+		if (tickBarrier.arrive(localSense)) {
+			run();
+			return;
+		}
+		tickBarrier.wait(localSense);
+	}
+
+	uint64_t getTicks() const { return ticks; }
+};
+
+template <typename B> double ticksPerSecond(const long tiles,
+	const long ticks)
+{
+	B barrier;
+	vector<thread> threads;
+	for (long i = 0; i < tiles; i++) {
+		barrier.incrementTaskCount();
+	}
+	auto begin = chrono::steady_clock::now();
+	for (long i = 0; i < tiles; i++) {
+		threads.push_back(thread([&barrier, ticks]() {
+			for (long j = 0; j < ticks; j++) {
+				barrier.releaseToRun();
+			}
+			barrier.decrementTaskCount();
+		}));
+	}
+	for (auto& t: threads) {
+		t.join();
+	}
+	chrono::duration<double> elapsed =
+		chrono::steady_clock::now() - begin;
+	return barrier.getTicks() / elapsed.count();
+}
+
+int main(int argc, char *argv[])
+{
+	long ticks = 2000;
+	if (argc > 1) {
+		ticks = atol(argv[1]);
+	}
+	cout << "Tiles, legacy ticks/s, sense ticks/s, speedup" << endl;
+	const long tileCounts[] = {16, 64, 256};
+	for (auto tiles: tileCounts) {
+		double legacy = ticksPerSecond<LegacyBarrier>(tiles, ticks);
+		double sense = ticksPerSecond<SenseBarrier>(tiles, ticks);
+		cout << tiles << ", " << legacy << ", " << sense << ", ";
+		cout << sense / legacy << endl;
+	}
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <utility>
+#include <tuple>
+#include <mutex>
+#include "memorypacket.hpp"
+#include "mux.hpp"
+#include "coalesce.hpp"
+
+using namespace std;
+
+Coalescer::Coalescer(const uint64_t& ticks):
+	window(ticks), packets(0), bursts(0), bytesAsked(0), bytesRead(0),
+	waited(0)
+{
+}
+
+//a tile can be gone before its burst is answered - not its packet
+Coalescer::~Coalescer()
+{
+	for (auto& burst: issued) {
+		delete burst.first;
+	}
+}
+
+void Coalescer::add(MemoryPacket *packet, const uint64_t& tick)
+{
+	const uint64_t address = packet->getRemoteAddress();
+	const uint64_t low = address & ~(COALESCE_LINE - 1);
+	const uint64_t high = (address + packet->getRequestSize() +
+		COALESCE_LINE - 1) & ~(COALESCE_LINE - 1);
+	packets++;
+	bytesAsked += packet->getRequestSize();
+	for (auto& burst: open) {
+		if (low > burst.high || high < burst.low ||
+			max(high, burst.high) - min(low, burst.low) >
+			COALESCE_SPAN) {
+			continue;
+		}
+		burst.low = min(low, burst.low);
+		burst.high = max(high, burst.high);
+		burst.members.push_back(packet);
+		burst.arrived.push_back(tick);
+		return;
+	}
+	Burst burst;
+	burst.low = low;
+	burst.high = high;
+	burst.opened = tick;
+	burst.members.push_back(packet);
+	burst.arrived.push_back(tick);
+	open.push_back(burst);
+}
+
+//bursts whose window is up, oldest first
+void Coalescer::close(const uint64_t& tick, vector<MemoryPacket *>& closed)
+{
+	for (auto it = open.begin(); it != open.end();) {
+		if (it->opened + window > tick) {
+			it++;
+			continue;
+		}
+		for (const auto& arrival: it->arrived) {
+			waited += tick - arrival;
+		}
+		bursts++;
+		if (it->members.size() == 1) {
+			bytesRead += it->members[0]->getRequestSize();
+			closed.push_back(it->members[0]);
+		} else {
+			MemoryPacket *packet = new MemoryPacket(
+				it->members[0]->getProcessor(), it->low, 0,
+				it->high - it->low);
+			bytesRead += it->high - it->low;
+			issued[packet] = it->members;
+			closed.push_back(packet);
+		}
+		it = open.erase(it);
+	}
+}
+
+//the requests DDR has just answered by answering packet
+void Coalescer::fanOut(MemoryPacket *packet, vector<MemoryPacket *>& members)
+{
+	auto burst = issued.find(packet);
+	if (burst == issued.end()) {
+		members.push_back(packet);
+		return;
+	}
+	members = burst->second;
+	issued.erase(burst);
+	delete packet;
+}
+
+//every request merged away is a DDR access saved
+void Coalescer::report(const unsigned long channel) const
+{
+	if (packets == 0) {
+		return;
+	}
+	cout << "Coalescing, channel " << channel << ": " << packets;
+	cout << " requests in " << bursts << " bursts, merge rate ";
+	cout << 100.0 * (packets - bursts) / packets << "%, ";
+	cout << packets - bursts << " DDR accesses saved (";
+	cout << (packets - bursts) * DDR_DELAY << " ticks of DDR_DELAY), ";
+	cout << bytesAsked << " bytes asked for in " << bytesRead;
+	cout << " read, mean window wait " << (double)waited / packets;
+	cout << " ticks" << endl;
+}
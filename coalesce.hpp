@@ -0,0 +1,50 @@
+//merging neighbouring requests at the root of a tree
+#include <cstdint>
+#include <map>
+#include <vector>
+#ifndef _COALESCE_CLASS_
+#define _COALESCE_CLASS_
+
+//requests are merged a line at a time - one that touches or overlaps a
+//burst's lines joins it, so long as the burst stays in a DDR row
+static const uint64_t COALESCE_LINE = 64;
+static const uint64_t COALESCE_SPAN = 2048;
+
+class MemoryPacket;
+
+class Burst {
+public:
+	uint64_t low;
+	uint64_t high;
+	uint64_t opened;
+	std::vector<MemoryPacket *> members;
+	std::vector<uint64_t> arrived;
+};
+
+//Driven by the commits, like the DDR controller. A burst is held open
+//for the window from its first request, then goes to DDR as a single
+//packet of its own - and when that is answered each request it stood
+//for is answered too. A burst of one goes as the request itself.
+class Coalescer {
+private:
+	const uint64_t window;
+	std::vector<Burst> open;
+	//bursts out at DDR, and the requests they stand for
+	std::map<MemoryPacket *, std::vector<MemoryPacket *>> issued;
+	uint64_t packets;
+	uint64_t bursts;
+	uint64_t bytesAsked;
+	uint64_t bytesRead;
+	uint64_t waited;
+
+public:
+	Coalescer(const uint64_t& ticks);
+	~Coalescer();
+	void add(MemoryPacket *packet, const uint64_t& tick);
+	void close(const uint64_t& tick, std::vector<MemoryPacket *>& closed);
+	void fanOut(MemoryPacket *packet,
+		std::vector<MemoryPacket *>& members);
+	void report(const unsigned long channel) const;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include "memory.hpp"
+#include "coldstore.hpp"
+
+using namespace std;
+
+ColdStore::ColdStore(const uint64_t& limit, const string& spillFile):
+	coldBytes(0), coldLimit(limit), spillFd(-1), slotCount(0),
+	compressed(0), decompressed(0), zeroPages(0), spilled(0),
+	unspilled(0)
+{
+	if (spillFile.empty()) {
+		return;
+	}
+	spillFd = open(spillFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (spillFd < 0) {
+		cerr << "ColdStore could not open " << spillFile << endl;
+		throw "ColdStore spill error";
+	}
+	//nobody else needs the name - the space goes when we close it
+	unlink(spillFile.c_str());
+}
+
+ColdStore::~ColdStore()
+{
+	if (spillFd >= 0) {
+		close(spillFd);
+	}
+}
+
+void ColdStore::spill(ColdPage& page)
+{
+	if (freeSlots.empty()) {
+		page.slot = slotCount++;
+	} else {
+		page.slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	if (pwrite(spillFd, page.data.constData(), page.length,
+		page.slot << CHUNK_SHIFT) != (ssize_t)page.length) {
+		cerr << "ColdStore could not spill a page" << endl;
+		throw "ColdStore spill error";
+	}
+	page.data.clear();
+	page.spilled = true;
+	spilled++;
+}
+
+//a page that won't compress goes straight to the file, if there is one
+void ColdStore::put(const uint64_t& index, const uint8_t *chunk)
+{
+	if (all_of(chunk, chunk + CHUNK_SIZE,
+		[](const uint8_t b) { return b == 0; })) {
+		zeroPages++;
+		return;
+	}
+	ColdPage& page = pages[index];
+	page.data = qCompress(chunk, CHUNK_SIZE, 1);
+	page.raw = (uint64_t)page.data.size() > LOW_ENTROPY;
+	page.spilled = false;
+	if (page.raw) {
+		page.data = QByteArray((const char *)chunk, CHUNK_SIZE);
+	} else {
+		compressed++;
+	}
+	page.length = page.data.size();
+	if (page.raw && spillFd >= 0) {
+		spill(page);
+		page.age = ages.end();
+		return;
+	}
+	page.age = ages.insert(ages.end(), index);
+	coldBytes += page.length;
+	while (spillFd >= 0 && coldBytes > coldLimit && !ages.empty()) {
+		ColdPage& oldest = pages[ages.front()];
+		coldBytes -= oldest.length;
+		spill(oldest);
+		oldest.age = ages.end();
+		ages.pop_front();
+	}
+}
+
+//false if the page was never kept - it reads as zero
+bool ColdStore::take(const uint64_t& index, uint8_t *chunk)
+{
+	auto found = pages.find(index);
+	if (found == pages.end()) {
+		return false;
+	}
+	ColdPage& page = found->second;
+	if (page.spilled) {
+		page.data.resize(page.length);
+		if (pread(spillFd, page.data.data(), page.length,
+			page.slot << CHUNK_SHIFT) != (ssize_t)page.length) {
+			cerr << "ColdStore could not read back a page" << endl;
+			throw "ColdStore spill error";
+		}
+		freeSlots.push_back(page.slot);
+		unspilled++;
+	} else {
+		ages.erase(page.age);
+		coldBytes -= page.length;
+	}
+	if (page.raw) {
+		memcpy(chunk, page.data.constData(), CHUNK_SIZE);
+	} else {
+		const QByteArray plain = qUncompress(page.data);
+		memcpy(chunk, plain.constData(), CHUNK_SIZE);
+		decompressed++;
+	}
+	pages.erase(found);
+	return true;
+}
+
+void ColdStore::report(const string& name, const uint64_t& hot) const
+{
+	cout << name << ": " << hot << " hot pages, " <<
+		ages.size() << " cold pages in " << coldBytes << " bytes, " <<
+		(slotCount - freeSlots.size()) << " spilled" << endl;
+	cout << name << ": " << compressed << " compressed, " <<
+		decompressed << " decompressed, " << zeroPages <<
+		" zero pages dropped, " << spilled << " spills, " <<
+		unspilled << " read back" << endl;
+}
@@ -0,0 +1,55 @@
+//ColdStore class
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <QByteArray>
+#ifndef _COLDSTORE_CLASS_
+#define _COLDSTORE_CLASS_
+
+//a page that compresses worse than this is kept (or spilled) raw
+const uint64_t LOW_ENTROPY = 3 * (CHUNK_SIZE >> 2);
+
+class ColdPage {
+public:
+	QByteArray data;
+	bool raw;
+	bool spilled;
+	uint64_t slot;
+	uint64_t length;
+	std::list<uint64_t>::iterator age;
+};
+
+//chunks a tiered Memory has let go cold - compressed in memory, the
+//oldest spilled a chunk sized slot at a time to a file. Zero pages
+//are not kept at all. The owning Memory serialises every call.
+class ColdStore {
+
+private:
+	std::unordered_map<uint64_t, ColdPage> pages;
+	//pages still held in memory, oldest first
+	std::list<uint64_t> ages;
+	uint64_t coldBytes;
+	const uint64_t coldLimit;
+	int spillFd;
+	std::vector<uint64_t> freeSlots;
+	uint64_t slotCount;
+	uint64_t compressed;
+	uint64_t decompressed;
+	uint64_t zeroPages;
+	uint64_t spilled;
+	uint64_t unspilled;
+	void spill(ColdPage& page);
+
+public:
+	ColdStore(const uint64_t& limit, const std::string& spillFile);
+	~ColdStore();
+	bool holds(const uint64_t& index) const
+		{ return pages.find(index) != pages.end(); }
+	void put(const uint64_t& index, const uint8_t *chunk);
+	bool take(const uint64_t& index, uint8_t *chunk);
+	void report(const std::string& name, const uint64_t& hot) const;
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <map>
+#include <utility>
+#include <condition_variable>
+#include "mainwindow.h"
+#include "memory.hpp"
+#include "memorypacket.hpp"
+#include "processor.hpp"
+#include "ddr.hpp"
+
+using namespace std;
+
+DDRController::DDRController(const long policy, GlobalMemory& global):
+	scheduling(policy), globalMemory(global), banks(DDR_BANKS),
+	busFree(0), nextRefresh(DDR_TREFI * GLOBALCLOCKSLOW), accesses(0),
+	hits(0), empties(0), conflicts(0), refreshes(0), queued(0), latency(0)
+{
+}
+
+const string DDRController::name(const long policy)
+{
+	switch (policy) {
+	case FCFS_DDR:
+		return string("FCFS");
+	case FR_FCFS_DDR:
+		return string("FR-FCFS");
+	default:
+		return string("flat");
+	}
+}
+
+//place the request in its bank and row - the channel address, not the
+//global one, so interleaving leaves each channel a sweep of its own
+void DDRController::enqueue(MemoryPacket *packet, const uint64_t& tick)
+{
+	const uint64_t address =
+		globalMemory.channelAddress(packet->getRemoteAddress());
+	DDRRequest request;
+	request.packet = packet;
+	request.bank = (address / DDR_ROW_BYTES) % DDR_BANKS;
+	request.row = address / (DDR_ROW_BYTES * DDR_BANKS);
+	request.arrived = tick;
+	request.done = 0;
+	queue.push_back(request);
+}
+
+//FCFS only ever looks at the oldest request. FR-FCFS takes the oldest
+//row hit on a ready bank, then the oldest request on a ready bank -
+//unless the oldest of all has waited too long
+bool DDRController::pick(const uint64_t& tick, uint64_t& chosen) const
+{
+	if (queue.empty()) {
+		return false;
+	}
+	if (scheduling == FCFS_DDR ||
+		tick - queue.front().arrived >= DDR_STARVE * GLOBALCLOCKSLOW) {
+		chosen = 0;
+		return banks[queue.front().bank].ready <= tick;
+	}
+	bool found = false;
+	for (uint64_t i = 0; i < queue.size(); i++) {
+		const DDRBank& bank = banks[queue[i].bank];
+		if (bank.ready > tick) {
+			continue;
+		}
+		if (bank.open && bank.row == queue[i].row) {
+			chosen = i;
+			return true;
+		}
+		if (!found) {
+			chosen = i;
+			found = true;
+		}
+	}
+	return found;
+}
+
+//open the row if need be, then the column - data follows DDR_TCAS on
+//when the bus is free. The bank can take its next column as the bus
+//finishes with this one
+void DDRController::issue(DDRRequest& request, const uint64_t& tick)
+{
+	DDRBank& bank = banks[request.bank];
+	uint64_t column = tick;
+	if (bank.open && bank.row == request.row) {
+		hits++;
+	} else if (!bank.open) {
+		empties++;
+		column += DDR_TRCD * GLOBALCLOCKSLOW;
+	} else {
+		conflicts++;
+		column += (DDR_TRP + DDR_TRCD) * GLOBALCLOCKSLOW;
+	}
+	bank.open = true;
+	bank.row = request.row;
+	const uint64_t bursts = (request.packet->getRequestSize() +
+		DDR_BURST_BYTES - 1) / DDR_BURST_BYTES;
+	const uint64_t dataStart = max(column + DDR_TCAS * GLOBALCLOCKSLOW,
+		busFree);
+	request.done = dataStart + max(bursts, 1UL) * DDR_TBURST *
+		GLOBALCLOCKSLOW;
+	busFree = request.done;
+	bank.ready = request.done - DDR_TCAS * GLOBALCLOCKSLOW;
+	accesses++;
+	queued += tick - request.arrived;
+	latency += request.done - request.arrived;
+}
+
+//every bank closes its row and is out until the refresh is done
+void DDRController::refresh(const uint64_t& tick)
+{
+	uint64_t start = tick;
+	for (const auto& bank: banks) {
+		start = max(start, bank.ready);
+	}
+	for (auto& bank: banks) {
+		bank.open = false;
+		bank.ready = start + DDR_TRFC * GLOBALCLOCKSLOW;
+	}
+	nextRefresh += DDR_TREFI * GLOBALCLOCKSLOW;
+	refreshes++;
+}
+
+//a tick of the controller - hand back what is through, then issue
+void DDRController::tick(const uint64_t& tick,
+	vector<MemoryPacket *>& served)
+{
+	for (uint64_t i = 0; i < serving.size();) {
+		if (serving[i].done <= tick) {
+			served.push_back(serving[i].packet);
+			serving.erase(serving.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	if (tick >= nextRefresh) {
+		refresh(tick);
+	}
+	uint64_t chosen = 0;
+	if (pick(tick, chosen)) {
+		issue(queue[chosen], tick);
+		serving.push_back(queue[chosen]);
+		queue.erase(queue.begin() + chosen);
+	}
+}
+
+void DDRController::report(const unsigned long channel) const
+{
+	if (accesses == 0) {
+		return;
+	}
+	cout << "DDR channel " << channel << ", " << name(scheduling) << ": ";
+	cout << accesses << " accesses, row hits " << 100.0 * hits / accesses;
+	cout << "%, closed " << 100.0 * empties / accesses << "%, conflicts ";
+	cout << 100.0 * conflicts / accesses << "%, mean latency ";
+	cout << (double)latency / accesses << " ticks (queued ";
+	cout << (double)queued / accesses << "), " << refreshes;
+	cout << " refreshes" << endl;
+}
@@ -0,0 +1,87 @@
+//banked DDR controller at the root of a tree
+#include <cstdint>
+#include <vector>
+#include <string>
+#ifndef _DDR_CLASS_
+#define _DDR_CLASS_
+
+//how the controller picks the next request to issue - FLAT_DDR is no
+//controller, every access waits DDR_DELAY
+enum DDRScheduling { FLAT_DDR, FCFS_DDR, FR_FCFS_DDR };
+
+//a channel's geometry - a row of DDR_ROW_BYTES in each bank, row then
+//bank then column from the top of a channel address, so a sweep stays
+//in a row until it runs off the end of it
+static const uint64_t DDR_BANKS = 8;
+static const uint64_t DDR_ROW_BYTES = 8192;
+static const uint64_t DDR_BURST_BYTES = 64;
+//timings in ticks - a row miss on a closed bank comes to about
+//DDR_DELAY, a hit to a third of it
+static const uint64_t DDR_TRP = 10;
+static const uint64_t DDR_TRCD = 10;
+static const uint64_t DDR_TCAS = 10;
+static const uint64_t DDR_TBURST = 2;
+static const uint64_t DDR_TREFI = 3900;
+static const uint64_t DDR_TRFC = 128;
+//FR-FCFS lets a row hit overtake older requests - but not ones that
+//have queued this long
+static const uint64_t DDR_STARVE = 1000;
+
+class MemoryPacket;
+class GlobalMemory;
+
+class DDRRequest {
+public:
+	MemoryPacket *packet;
+	uint64_t bank;
+	uint64_t row;
+	uint64_t arrived;
+	uint64_t done;
+};
+
+class DDRBank {
+public:
+	bool open;
+	uint64_t row;
+	//tick it can take its next command
+	uint64_t ready;
+	DDRBank(): open(false), row(0), ready(0) {}
+};
+
+//Driven by the commits, so with no tile running. The root hands over
+//each request it grants, and every tick the controller issues at most
+//one - the command bus is shared - and gives back the ones whose data
+//is through.
+class DDRController {
+private:
+	const long scheduling;
+	GlobalMemory& globalMemory;
+	std::vector<DDRBank> banks;
+	std::vector<DDRRequest> queue;
+	std::vector<DDRRequest> serving;
+	//tick the data bus is next free
+	uint64_t busFree;
+	uint64_t nextRefresh;
+	uint64_t accesses;
+	uint64_t hits;
+	uint64_t empties;
+	uint64_t conflicts;
+	uint64_t refreshes;
+	uint64_t queued;
+	uint64_t latency;
+	bool pick(const uint64_t& tick, uint64_t& chosen) const;
+	void issue(DDRRequest& request, const uint64_t& tick);
+	void refresh(const uint64_t& tick);
+
+public:
+	DDRController(const long policy, GlobalMemory& global);
+	//the quickest a request can be through - a hit on a burst
+	static uint64_t fastest()
+		{ return DDR_TCAS + DDR_TBURST; }
+	static const std::string name(const long policy);
+	void enqueue(MemoryPacket *packet, const uint64_t& tick);
+	void tick(const uint64_t& tick, std::vector<MemoryPacket *>& served);
+	void report(const unsigned long channel) const;
+};
+
+#endif
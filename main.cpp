@@ -1,9 +1,8 @@
 #include <iostream>
+#include "nocconfig.hpp"
 #include "mainwindow.h"
 #include <QApplication>
 
-static const unsigned long PAGE_SHIFT = 10;
-
 using namespace std;
 
 void usage() {
@@ -12,20 +11,49 @@ void usage() {
     cout << "---------" << endl;
     cout << "-b    Memory blocks: default 4" << endl;
     cout << "-s    Memory block size: default 1GB" << endl;
+    cout << "-i    Interleave blocks every 2^n bytes (default: page size)" << endl;
     cout << "-r    Rows of CPUs in NoC (default 16)" << endl;
     cout << "-c    Columns of CPUs in NoC (default 16)" << endl;
     cout << "-p    Page size in power of 2 (default 10)" << endl;
+    cout << "-t    Worker threads running tiles as fibers" << endl;
+    cout << "      (default 0: one thread per tile)" << endl;
+    cout << "-q    Ticks per synchronisation quantum (default 1: strict)" << endl;
+    cout << "-w    Time Warp: tiles run up to this many ticks ahead" << endl;
+    cout << "      and roll back on conflict (default 0: off)" << endl;
+    cout << "-m    Memory snapshot: map it if it matches this run," << endl;
+    cout << "      else build memory and save it there" << endl;
+    cout << "-h    Tier global memory: MB kept uncompressed" << endl;
+    cout << "      (default 0: no tiers)" << endl;
+    cout << "-z    MB of compressed pages kept before spilling" << endl;
+    cout << "-f    Spill file for the coldest pages (default: none)" << endl;
+    cout << "-n    Network: 0 Mux trees (default), 1 analytic model," << endl;
+    cout << "      2 Mux trees checked against the model" << endl;
+    cout << "-x    Ticks a hop on the tile to tile mesh" << endl;
+    cout << "      (default 0: tiles signal through memory)" << endl;
+    cout << "-y    Bytes a mesh link carries a tick (default 16)" << endl;
+    cout << "-a    Mux arbitration: 0 left first (default), 1 round robin," << endl;
+    cout << "      2 oldest first, 3 weighted by subtree size" << endl;
+    cout << "-o    Split transactions a tile can have outstanding" << endl;
+    cout << "      (default 0: each request blocks the tile)" << endl;
+    cout << "-d    DDR: 0 flat delay (default), 1 banked FCFS," << endl;
+    cout << "      2 banked FR-FCFS" << endl;
+    cout << "-g    Ticks the root holds a request to merge neighbours" << endl;
+    cout << "      into one DDR burst (default 0: no merging)" << endl;
+    cout << "-e    CSV file for per-Mux congestion statistics" << endl;
+    cout << "      (default: none)" << endl;
+    cout << "-l    Ticks a statistics window (default 10000)" << endl;
+    cout << "-v    Virtual channels a port on flit level wormhole" << endl;
+    cout << "      routers (default 0: Muxes move whole packets)" << endl;
+    cout << "-k    Flits each virtual channel buffers (default 4)" << endl;
+    cout << "-u    Strict run's finishing ticks: -q 1 writes them," << endl;
+    cout << "      other runs report how far off they finished" << endl;
     cout << "-?    Print this message and exit" << endl;
 }
 
 
 int main(int argc, char *argv[])
 {
-    long memoryBlocks = 1;
-    long blockSize = 1024 * 1024 * 1024;
-    long rows = 16;
-    long columns = 16;
-    long pageShift = PAGE_SHIFT;
+    NocConfig config;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-?") == 0) {
@@ -33,23 +61,103 @@ int main(int argc, char *argv[])
             exit(EXIT_SUCCESS);
         }
         if (strcmp(argv[i], "-b") == 0) {
-            memoryBlocks = atol(argv[++i]);
+            config.memoryBlocks = atol(argv[++i]);
             continue;
         }
         if (strcmp(argv[i], "-s") == 0) {
-            blockSize = atol(argv[++i]);
+            config.blockSize = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-i") == 0) {
+            config.interleaveShift = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-m") == 0) {
+            config.snapshotFile = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "-h") == 0) {
+            config.hotLimit = atol(argv[++i]) << 20;
+            continue;
+        }
+        if (strcmp(argv[i], "-z") == 0) {
+            config.coldLimit = atol(argv[++i]) << 20;
+            continue;
+        }
+        if (strcmp(argv[i], "-f") == 0) {
+            config.spillFile = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "-n") == 0) {
+            config.network = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-x") == 0) {
+            config.meshLatency = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-y") == 0) {
+            config.meshWidth = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-a") == 0) {
+            config.arbitration = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-o") == 0) {
+            config.outstanding = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-d") == 0) {
+            config.ddrScheduling = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-g") == 0) {
+            config.coalesceWindow = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-e") == 0) {
+            config.statsFile = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "-l") == 0) {
+            config.statsWindow = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-v") == 0) {
+            config.virtualChannels = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-k") == 0) {
+            config.channelDepth = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-u") == 0) {
+            config.strictFile = argv[++i];
             continue;
         }
         if (strcmp(argv[i], "-r") == 0) {
-            rows = atol(argv[++i]);
+            config.rows = atol(argv[++i]);
             continue;
         }
         if (strcmp(argv[i], "-c") == 0) {
-            columns = atol(argv[++i]);
+            config.columns = atol(argv[++i]);
             continue;
         }
         if (strcmp(argv[i], "-p") == 0) {
-            pageShift = atol(argv[++i]);
+            config.pageShift = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-t") == 0) {
+            config.workerThreads = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-q") == 0) {
+            config.quantum = atol(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-w") == 0) {
+            config.warpWindow = atol(argv[++i]);
             continue;
         }
 
@@ -58,7 +166,7 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
-    long totalTiles = rows * columns;
+    long totalTiles = config.rows * config.columns;
     if ((totalTiles == 0) || (totalTiles & (totalTiles - 1))) {
         cout << "Must have power of two for number of tiles." << endl;
         exit(EXIT_FAILURE);
@@ -68,11 +176,7 @@ int main(int argc, char *argv[])
 
     QApplication a(argc, argv);
     MainWindow w;
-    w.setColumns(columns);
-    w.setRows(rows);
-    w.setPageShift(pageShift);
-    w.setMemoryBlocks(memoryBlocks);
-    w.setBlockSize(blockSize);
+    w.setConfig(config);
     w.show();
 
     return a.exec();
@@ -8,6 +8,7 @@
 #include "ControlThread.hpp"
 #include "memorypacket.hpp"
 #include "mux.hpp"
+#include "memory.hpp"
 #include "noc.hpp"
 #include "tile.hpp"
 
@@ -30,20 +31,16 @@ MainWindow::~MainWindow()
 class ExecuteFunctor
 {
 private:
-    uint64_t columns;
-    uint64_t rows;
-    uint64_t pageShift;
-    uint64_t memoryBlocks;
-    uint64_t blockSize;
+    NocConfig config;
     MainWindow *mW;
 
 public:
-    ExecuteFunctor(uint64_t c, uint64_t r, uint64_t pS, uint64_t mB, uint64_t bS, MainWindow *wind):
-        columns(c), rows(r), pageShift(pS), memoryBlocks(mB), blockSize(bS), mW(wind) {}
+    ExecuteFunctor(const NocConfig& c, MainWindow *wind):
+        config(c), mW(wind) {}
 
     void operator() ()
     {
-        Noc networkTiles(columns, rows, pageShift, blockSize, mW, memoryBlocks);
+        Noc networkTiles(config, mW);
         //Let's Go!
         networkTiles.executeInstructions();
     }
@@ -55,12 +52,12 @@ void MainWindow::on_pushButton_clicked()
     //disable button before we start
     ui->label->setText("Counting...");
 
-    long totalTiles = rows * columns;
+    long totalTiles = config.rows * config.columns;
     if ((totalTiles == 0) || (totalTiles & (totalTiles - 1))) {
         cerr << "Must have power of two for number of tiles." << endl;
         exit(EXIT_FAILURE);
     }
-    ExecuteFunctor eF(columns, rows, pageShift, memoryBlocks, blockSize, this);
+    ExecuteFunctor eF(config, this);
     std::thread t(eF);
     t.detach();
 
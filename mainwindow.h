@@ -4,6 +4,8 @@
 #include <QMainWindow>
 #include <QLCDNumber>
 #include <mutex>
+#include <string>
+#include "nocconfig.hpp"
 
 namespace Ui {
 class MainWindow;
@@ -15,22 +17,14 @@ class MainWindow : public QMainWindow
 
 private:
     Ui::MainWindow *ui;
-    uint64_t rows;
-    uint64_t columns;
-    uint64_t pageShift;
-    uint64_t blockSize;
-    uint64_t memoryBlocks;
+    NocConfig config;
     std::mutex hardFaultMutex;
     std::mutex smallFaultMutex;
 
 public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
-    void setRows(const uint64_t r) {rows = r;}
-    void setColumns(const uint64_t c) {columns = c;}
-    void setPageShift(const uint64_t pS) {pageShift = pS;}
-    void setBlockSize(const uint64_t bS) {blockSize = bS;}
-    void setMemoryBlocks(const uint64_t mB) {memoryBlocks = mB;}
+    void setConfig(const NocConfig& c) {config = c;}
     int currentCycles;
 
 private slots:
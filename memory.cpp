@@ -1,109 +1,504 @@
 #include <iostream>
 #include <map>
+#include <string>
 #include <vector>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <mutex>
+#include <atomic>
+#include <sys/mman.h>
 #include "tree.hpp"
 #include "memorypacket.hpp"
 #include "mux.hpp"
 #include "memory.hpp"
+#include "coldstore.hpp"
 
 using namespace std;
 
-Memory::Memory(const uint64_t& startAddress, const uint64_t& size):
-	start(startAddress), memorySize(size)
-{}
+Memory::Memory(const uint64_t& startAddress, const uint64_t& size,
+	const MemoryTiers& tiers):
+	start(startAddress), memorySize(size), directory(nullptr),
+	directorySize(0), flat(nullptr), mapped(false),
+	writeShards(WRITE_SHARDS), coldStore(nullptr), hotLimit(0),
+	clockHand(0), keepingUndo(false), undoBase(0)
+{
+	if (memorySize <= FLAT_LIMIT) {
+		const uint64_t lines = (memorySize + CACHE_LINE - 1) /
+			CACHE_LINE;
+		flat = (uint8_t *)aligned_alloc(CACHE_LINE, lines * CACHE_LINE);
+		if (!flat) {
+			cerr << "Memory could not allocate backing store" << endl;
+			throw "Memory class allocation error";
+		}
+		memset(flat, 0, lines * CACHE_LINE);
+		return;
+	}
+	if (tiers.tiered()) {
+		//at least a chunk per shard, or hot chunks thrash
+		hotLimit = max(tiers.hotLimit >> CHUNK_SHIFT, WRITE_SHARDS);
+		coldStore = new ColdStore(tiers.coldLimit, tiers.spillFile);
+	} else if (memorySize >= MAP_THRESHOLD) {
+		void *block = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (block != MAP_FAILED) {
+			flat = (uint8_t *)block;
+			mapped = true;
+			madvise(flat, memorySize, MADV_HUGEPAGE);
+			return;
+		}
+		cerr << "Memory could not map block, using chunks" << endl;
+	}
+	const uint64_t chunks = (memorySize + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+	directorySize = ((chunks - 1) >> TABLE_SHIFT) + 1;
+	directory = new atomic<ChunkSlot *>[directorySize];
+	for (uint64_t i = 0; i < directorySize; i++) {
+		directory[i].store(nullptr);
+	}
+}
 
-uint8_t Memory::readByte(const uint64_t& address)
+//only used while the Noc is built - nothing else can see either block
+Memory::Memory(Memory&& other) noexcept:
+	start(other.start), memorySize(other.memorySize),
+	directory(other.directory), directorySize(other.directorySize),
+	flat(other.flat), mapped(other.mapped),
+	writeShards(move(other.writeShards)), coldStore(other.coldStore),
+	hotLimit(other.hotLimit), hotChunks(move(other.hotChunks)),
+	clockHand(other.clockHand), rootMux(other.rootMux),
+	keepingUndo(other.keepingUndo), undoBase(other.undoBase), undoLog(move(other.undoLog))
 {
-	uint8_t retVal = 0;
+	other.directory = nullptr;
+	other.directorySize = 0;
+	other.flat = nullptr;
+	other.mapped = false;
+	other.coldStore = nullptr;
+}
 
-	if (address < start || address > start + memorySize) {
-		cout << "Memory::readByte out of range" << endl;
-		throw "Memory class range error";
+Memory::~Memory()
+{
+	release();
+}
+
+void Memory::release()
+{
+	if (flat && mapped) {
+		munmap(flat, memorySize);
+	} else {
+		free(flat);
+	}
+	flat = nullptr;
+	mapped = false;
+	for (uint64_t i = 0; i < directorySize; i++) {
+		ChunkSlot *table = directory[i].load();
+		if (!table) {
+			continue;
+		}
+		for (uint64_t j = 0; j < (1 << TABLE_SHIFT); j++) {
+			free(table[j].load());
+		}
+		delete[] table;
+	}
+	delete[] directory;
+	directory = nullptr;
+	directorySize = 0;
+	delete coldStore;
+	coldStore = nullptr;
+}
+
+//null if nothing has been written there - it reads as zero
+const uint8_t* Memory::chunkFor(const uint64_t& offset) const
+{
+	ChunkSlot *table = directory[offset >> (CHUNK_SHIFT + TABLE_SHIFT)].
+		load(memory_order_acquire);
+	if (!table) {
+		return nullptr;
+	}
+	return table[(offset >> CHUNK_SHIFT) & ((1 << TABLE_SHIFT) - 1)].
+		load(memory_order_acquire);
+}
+
+uint8_t* Memory::touchChunk(const uint64_t& offset)
+{
+	atomic<ChunkSlot *>& tableSlot =
+		directory[offset >> (CHUNK_SHIFT + TABLE_SHIFT)];
+	ChunkSlot *table = tableSlot.load(memory_order_acquire);
+	uint8_t *chunk = nullptr;
+	if (table) {
+		chunk = table[(offset >> CHUNK_SHIFT) &
+			((1 << TABLE_SHIFT) - 1)].load(memory_order_acquire);
+		if (chunk) {
+			return chunk;
+		}
+	}
+	//first touch - allocate under the lock, publish for the readers
+	unique_lock<mutex> lck(allocLock);
+	table = tableSlot.load(memory_order_relaxed);
+	if (!table) {
+		table = new ChunkSlot[1 << TABLE_SHIFT];
+		for (uint64_t i = 0; i < (1 << TABLE_SHIFT); i++) {
+			table[i].store(nullptr, memory_order_relaxed);
+		}
+		tableSlot.store(table, memory_order_release);
 	}
+	ChunkSlot& chunkSlot =
+		table[(offset >> CHUNK_SHIFT) & ((1 << TABLE_SHIFT) - 1)];
+	chunk = chunkSlot.load(memory_order_relaxed);
+	if (!chunk) {
+		chunk = (uint8_t *)calloc(coldStore ? CHUNK_SIZE + 1 :
+			CHUNK_SIZE, 1);
+		if (!chunk) {
+			cerr << "Memory could not allocate backing store" << endl;
+			throw "Memory class allocation error";
+		}
+		chunkSlot.store(chunk, memory_order_release);
+	}
+	return chunk;
+}
 
-	try {
-        retVal = contents.value(address);
+//tiered blocks - the chunk holding offset, with its shard locked and
+//thawed if it had gone cold. Null if it reads as zero and create is
+//false. Only tierLock holders change a tiered block's chunk slots.
+uint8_t* Memory::pinChunk(const uint64_t& offset, const bool create,
+	unique_lock<mutex>& lck)
+{
+	const uint64_t index = offset >> CHUNK_SHIFT;
+	lck = unique_lock<mutex>(writeShards[index % WRITE_SHARDS]);
+	uint8_t *chunk = (uint8_t *)chunkFor(offset);
+	if (chunk) {
+		chunk[CHUNK_SIZE] = 1;
+		return chunk;
 	}
-	catch (const out_of_range& err)
-	{
-		contents[address] = 0;
+	lck.unlock();
+	unique_lock<mutex> tierLck(tierLock);
+	chunk = (uint8_t *)chunkFor(offset);
+	if (!chunk && (create || coldStore->holds(index))) {
+		makeRoom();
+		lck.lock();
+		chunk = touchChunk(offset);
+		coldStore->take(index, chunk);
+		hotChunks.push_back(index);
+	} else {
+		lck.lock();
 	}
+	if (chunk) {
+		chunk[CHUNK_SIZE] = 1;
+	}
+	return chunk;
+}
 
-	return retVal;
+//clock sweep - a chunk touched since the hand last passed gets another
+//lap, the first one that wasn't goes cold. Caller holds tierLock.
+void Memory::makeRoom()
+{
+	while (hotChunks.size() >= hotLimit) {
+		if (clockHand >= hotChunks.size()) {
+			clockHand = 0;
+		}
+		const uint64_t index = hotChunks[clockHand];
+		unique_lock<mutex> lck(writeShards[index % WRITE_SHARDS]);
+		ChunkSlot& slot = directory[index >> TABLE_SHIFT].load(
+			memory_order_relaxed)[index & ((1 << TABLE_SHIFT) - 1)];
+		uint8_t *chunk = slot.load(memory_order_relaxed);
+		if (chunk[CHUNK_SIZE]) {
+			chunk[CHUNK_SIZE] = 0;
+			clockHand++;
+			continue;
+		}
+		coldStore->put(index, chunk);
+		slot.store(nullptr, memory_order_release);
+		lck.unlock();
+		free(chunk);
+		hotChunks[clockHand] = hotChunks.back();
+		hotChunks.pop_back();
+	}
 }
 
-uint64_t Memory::readLong(const uint64_t& address)
+bool Memory::holdsChunk(const uint64_t& offset) const
 {
-	uint64_t retVal = 0;
+	if (flat || chunkFor(offset)) {
+		return true;
+	}
+	if (!coldStore) {
+		return false;
+	}
+	unique_lock<mutex> tierLck(tierLock);
+	return chunkFor(offset) || coldStore->holds(offset >> CHUNK_SHIFT);
+}
 
-	if (address < start || address + sizeof(uint64_t) > start + memorySize)
-	{
-		cout << "Memory::readLong out of range" << endl;
+void Memory::checkRange(const uint64_t& address, const uint64_t& size,
+	const char *caller) const
+{
+	if (address < start || address + size > start + memorySize) {
+		cout << "Memory::" << caller << " out of range" << endl;
 		throw "Memory class range error";
 	}
+}
 
-	uint8_t in[sizeof(uint64_t)];
+//offset is from start - a naturally aligned word never crosses a chunk
+static bool atomicWord(const uint64_t& offset, const uint64_t& size)
+{
+	return (size == 1 || size == 2 || size == 4 || size == 8) &&
+		(offset & (size - 1)) == 0;
+}
 
-    for (uint8_t i = 0; i < sizeof(uint64_t); i++)
-	{	
-		try {
-            in[i] = (uint8_t)contents.value(address + i);
+void Memory::load(uint64_t offset, uint8_t *out, uint64_t size) const
+{
+	if (coldStore) {
+		//thawing a chunk moves it, it doesn't change what it holds
+		Memory *self = const_cast<Memory *>(this);
+		while (size > 0) {
+			const uint64_t inChunk = offset & (CHUNK_SIZE - 1);
+			const uint64_t count = min(size, CHUNK_SIZE - inChunk);
+			unique_lock<mutex> lck;
+			const uint8_t *chunk = self->pinChunk(offset, false, lck);
+			if (chunk) {
+				memcpy(out, chunk + inChunk, count);
+			} else {
+				memset(out, 0, count);
+			}
+			offset += count;
+			out += count;
+			size -= count;
+		}
+		return;
+	}
+	if (atomicWord(offset, size)) {
+		const uint8_t *host = flat;
+		if (host) {
+			host += offset;
+		} else if ((host = chunkFor(offset))) {
+			host += offset & (CHUNK_SIZE - 1);
+		} else {
+			memset(out, 0, size);
+			return;
+		}
+		switch (size) {
+		case 1:
+			*out = __atomic_load_n(host, __ATOMIC_ACQUIRE);
+			break;
+		case 2: {
+			uint16_t word = __atomic_load_n((const uint16_t *)host,
+				__ATOMIC_ACQUIRE);
+			memcpy(out, &word, size);
+			break;
+		}
+		case 4: {
+			uint32_t word = __atomic_load_n((const uint32_t *)host,
+				__ATOMIC_ACQUIRE);
+			memcpy(out, &word, size);
+			break;
+		}
+		default: {
+			uint64_t word = __atomic_load_n((const uint64_t *)host,
+				__ATOMIC_ACQUIRE);
+			memcpy(out, &word, size);
 		}
-		catch (const out_of_range& err)
-		{
-			contents[address + i] = 0;
 		}
+		return;
+	}
+	if (flat) {
+		memcpy(out, flat + offset, size);
+		return;
+	}
+	while (size > 0) {
+		const uint64_t inChunk = offset & (CHUNK_SIZE - 1);
+		const uint64_t count = min(size, CHUNK_SIZE - inChunk);
+		const uint8_t *chunk = chunkFor(offset);
+		if (chunk) {
+			memcpy(out, chunk + inChunk, count);
+		} else {
+			memset(out, 0, count);
+		}
+		offset += count;
+		out += count;
+		size -= count;
 	}
-	memcpy(&retVal, in, sizeof(uint64_t));
-	return retVal;
 }
 
-void Memory::writeByte(const uint64_t& address, const uint8_t& value)
+void Memory::store(uint64_t offset, const uint8_t *in, uint64_t size)
 {
-	if (address < start || address > start + memorySize) {
-		cout << "Memory::writeByte out of range" << endl;
-		throw "Memory class range error";
+	if (coldStore) {
+		while (size > 0) {
+			const uint64_t inChunk = offset & (CHUNK_SIZE - 1);
+			const uint64_t count = min(size, CHUNK_SIZE - inChunk);
+			unique_lock<mutex> lck;
+			memcpy(pinChunk(offset, true, lck) + inChunk, in, count);
+			offset += count;
+			in += count;
+			size -= count;
+		}
+		return;
+	}
+	if (atomicWord(offset, size)) {
+		uint8_t *host = flat ? flat + offset :
+			touchChunk(offset) + (offset & (CHUNK_SIZE - 1));
+		switch (size) {
+		case 1:
+			__atomic_store_n(host, *in, __ATOMIC_RELEASE);
+			break;
+		case 2: {
+			uint16_t word;
+			memcpy(&word, in, size);
+			__atomic_store_n((uint16_t *)host, word,
+				__ATOMIC_RELEASE);
+			break;
+		}
+		case 4: {
+			uint32_t word;
+			memcpy(&word, in, size);
+			__atomic_store_n((uint32_t *)host, word,
+				__ATOMIC_RELEASE);
+			break;
+		}
+		default: {
+			uint64_t word;
+			memcpy(&word, in, size);
+			__atomic_store_n((uint64_t *)host, word,
+				__ATOMIC_RELEASE);
+		}
+		}
+		return;
+	}
+	while (size > 0) {
+		const uint64_t inChunk = offset & (CHUNK_SIZE - 1);
+		const uint64_t count = min(size, CHUNK_SIZE - inChunk);
+		uint8_t *host = flat ? flat + offset :
+			touchChunk(offset) + inChunk;
+		unique_lock<mutex> lck(writeShards[(offset >> CHUNK_SHIFT) %
+			WRITE_SHARDS]);
+		memcpy(host, in, count);
+		lck.unlock();
+		offset += count;
+		in += count;
+		size -= count;
 	}
-
-	contents[address] = value;
 }
 
-void Memory::writeLong(const uint64_t& address, const uint64_t& value)
+//a zero fill leaves untouched chunks alone - they read as zero anyway
+void Memory::set(uint64_t offset, const uint8_t& value, uint64_t size)
 {
-	if (address < start || address + sizeof(uint64_t) > start + memorySize)
-	{
-		cout << "Memory::writeLong out of range" << endl;
-		throw "Memory class range error";
+	while (size > 0) {
+		const uint64_t inChunk = offset & (CHUNK_SIZE - 1);
+		const uint64_t count = min(size, CHUNK_SIZE - inChunk);
+		if (coldStore) {
+			unique_lock<mutex> lck;
+			uint8_t *chunk = pinChunk(offset, value != 0, lck);
+			if (chunk) {
+				memset(chunk + inChunk, value, count);
+			}
+			offset += count;
+			size -= count;
+			continue;
+		}
+		uint8_t *host = flat ? flat + offset : nullptr;
+		if (!host && (value != 0 || chunkFor(offset))) {
+			host = touchChunk(offset) + inChunk;
+		}
+		if (host) {
+			unique_lock<mutex> lck(writeShards[
+				(offset >> CHUNK_SHIFT) % WRITE_SHARDS]);
+			memset(host, value, count);
+		}
+		offset += count;
+		size -= count;
 	}
+}
 
-	uint8_t *valRep = (uint8_t *) &value;
-	for (uint i = 0; i < sizeof(uint64_t); i++)
-	{
-		contents[address + i] = *(valRep + i);
+void Memory::copyIn(const uint64_t& offset, const uint8_t *in,
+	const uint64_t& size)
+{
+	if (keepingUndo) {
+		unique_lock<mutex> lck(undoLock);
+		logUndo(start + offset, size);
+		store(offset, in, size);
+		return;
 	}
+	store(offset, in, size);
+}
+
+uint8_t Memory::readByte(const uint64_t& address)
+{
+	uint8_t retVal;
+	checkRange(address, sizeof(uint8_t), "readByte");
+	load(address - start, &retVal, sizeof(uint8_t));
+	return retVal;
+}
+
+//words are stored little endian, as the host has them
+uint16_t Memory::readWord16(const uint64_t& address)
+{
+	uint16_t retVal;
+	checkRange(address, sizeof(uint16_t), "readWord16");
+	load(address - start, (uint8_t *)&retVal, sizeof(uint16_t));
+	return retVal;
 }
 
 uint32_t Memory::readWord32(const uint64_t& address)
 {
-	uint32_t result = 0;
-	for (int i = 3; i >= 0; i--) {
-		char nextByte = readByte(address + i) << (i * 8);
-		result = result | nextByte;
-	}
-	return result;
+	uint32_t retVal;
+	checkRange(address, sizeof(uint32_t), "readWord32");
+	load(address - start, (uint8_t *)&retVal, sizeof(uint32_t));
+	return retVal;
+}
+
+uint64_t Memory::readLong(const uint64_t& address)
+{
+	uint64_t retVal;
+	checkRange(address, sizeof(uint64_t), "readLong");
+	load(address - start, (uint8_t *)&retVal, sizeof(uint64_t));
+	return retVal;
+}
+
+void Memory::writeByte(const uint64_t& address, const uint8_t& value)
+{
+	checkRange(address, sizeof(uint8_t), "writeByte");
+	copyIn(address - start, &value, sizeof(uint8_t));
 }
 
-void Memory::writeWord32(const uint64_t& address, const uint32_t& data)
+void Memory::writeWord16(const uint64_t& address, const uint16_t& value)
 {
-	char mask = 0xFF;
-	for (int i = 0; i < 4; i++) {
-		char byteToWrite = (data >> (i * 8)) & mask;
-		writeByte(address + i, byteToWrite);
+	checkRange(address, sizeof(uint16_t), "writeWord16");
+	copyIn(address - start, (const uint8_t *)&value, sizeof(uint16_t));
+}
+
+void Memory::writeWord32(const uint64_t& address, const uint32_t& value)
+{
+	checkRange(address, sizeof(uint32_t), "writeWord32");
+	copyIn(address - start, (const uint8_t *)&value, sizeof(uint32_t));
+}
+
+void Memory::writeLong(const uint64_t& address, const uint64_t& value)
+{
+	checkRange(address, sizeof(uint64_t), "writeLong");
+	copyIn(address - start, (const uint8_t *)&value, sizeof(uint64_t));
+}
+
+void Memory::readBlock(const uint64_t& address, uint8_t *out,
+	const uint64_t& size)
+{
+	checkRange(address, size, "readBlock");
+	load(address - start, out, size);
+}
+
+void Memory::writeBlock(const uint64_t& address, const uint8_t *in,
+	const uint64_t& size)
+{
+	checkRange(address, size, "writeBlock");
+	copyIn(address - start, in, size);
+}
+
+void Memory::fill(const uint64_t& address, const uint8_t& value,
+	const uint64_t& size)
+{
+	checkRange(address, size, "fill");
+	if (keepingUndo) {
+		unique_lock<mutex> lck(undoLock);
+		logUndo(address, size);
+		set(address - start, value, size);
+		return;
 	}
+	set(address - start, value, size);
 }
 
 uint64_t Memory::getSize() const
@@ -116,7 +511,318 @@ bool Memory::inRange(const uint64_t& address) const
 	return (address <= (start + memorySize - 1) && address >= start);
 }
 
+//caller holds undoLock
+void Memory::logUndo(const uint64_t& address, const uint64_t& size)
+{
+	for (uint64_t i = 0; i < size; i++) {
+		uint8_t old;
+		load(address - start + i, &old, sizeof(uint8_t));
+		undoLog.push_back(pair<uint64_t, uint8_t>(address + i, old));
+	}
+}
+
+uint64_t Memory::undoMark() const
+{
+	unique_lock<mutex> lck(undoLock);
+	return undoBase + undoLog.size();
+}
+
+//put back every byte written since mark
+void Memory::rewindTo(const uint64_t& mark)
+{
+	unique_lock<mutex> lck(undoLock);
+	while (undoBase + undoLog.size() > mark) {
+		store(undoLog.back().first - start, &undoLog.back().second,
+			sizeof(uint8_t));
+		undoLog.pop_back();
+	}
+}
+
+//nothing will rewind past mark - drop the older entries
+void Memory::forgetBefore(const uint64_t& mark)
+{
+	unique_lock<mutex> lck(undoLock);
+	while (undoBase < mark && !undoLog.empty()) {
+		undoLog.pop_front();
+		undoBase++;
+	}
+}
+
+//host pages holding anything but zeros - a mapped block only looks at
+//the pages the kernel has actually given it
+void Memory::imageRuns(vector<pair<uint64_t, uint64_t>>& runs) const
+{
+	const uint64_t pages = (memorySize + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+	vector<unsigned char> resident;
+	if (mapped) {
+		resident.resize(pages);
+		if (mincore(flat, memorySize, resident.data()) != 0) {
+			resident.assign(pages, 1);
+		}
+	}
+	vector<uint8_t> page(CHUNK_SIZE);
+	for (uint64_t i = 0; i < pages; i++) {
+		const uint64_t offset = i << CHUNK_SHIFT;
+		const uint64_t size = min(CHUNK_SIZE, memorySize - offset);
+		if (mapped && !(resident[i] & 1)) {
+			continue;
+		}
+		if (!holdsChunk(offset)) {
+			continue;
+		}
+		load(offset, page.data(), size);
+		if (all_of(page.begin(), page.begin() + size,
+			[](const uint8_t b) { return b == 0; })) {
+			continue;
+		}
+		if (!runs.empty() &&
+			runs.back().first + runs.back().second == offset) {
+			runs.back().second += size;
+		} else {
+			runs.push_back(pair<uint64_t, uint64_t>(offset, size));
+		}
+	}
+}
+
+//put a run back from a snapshot - a mapped block maps the file copy on
+//write, so processes sharing a snapshot share its clean pages
+void Memory::mapImage(const int fd, const uint64_t& fileOffset,
+	const uint8_t *data, const uint64_t& offset, const uint64_t& size)
+{
+	if (mapped && (size & (CHUNK_SIZE - 1)) == 0) {
+		void *at = mmap(flat + offset, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_FIXED, fd, fileOffset);
+		if (at == MAP_FAILED) {
+			cerr << "Memory could not map snapshot" << endl;
+			throw "Memory class snapshot error";
+		}
+		return;
+	}
+	for (uint64_t done = 0; done < size; done += CHUNK_SIZE) {
+		store(offset + done, data + done, min(CHUNK_SIZE, size - done));
+	}
+}
+
+void Memory::reportTiers(const string& name) const
+{
+	if (coldStore) {
+		coldStore->report(name, hotChunks.size());
+	}
+}
+
 void Memory::attachTree(Mux* root)
 {
 	rootMux = root;
 }
+
+GlobalMemory::GlobalMemory(const unsigned long count, const uint64_t& size,
+	const uint64_t& shift, const MemoryTiers& tiers):
+	channelSize(size), granuleShift(shift), channelShift(0),
+	shiftChannels(false)
+{
+	if (count == 0 || size & ((1UL << granuleShift) - 1)) {
+		cerr << "Memory blocks must be a whole number of interleave";
+		cerr << " granules" << endl;
+		throw "GlobalMemory interleave error";
+	}
+	if ((count & (count - 1)) == 0) {
+		shiftChannels = true;
+		while ((1UL << channelShift) < count) {
+			channelShift++;
+		}
+	}
+	channels.reserve(count);
+	//the caps are shared out, each channel spills to its own file
+	for (unsigned long i = 0; i < count; i++) {
+		MemoryTiers channelTiers(tiers.tiered() ?
+			max(tiers.hotLimit / count, (uint64_t)1) : 0,
+			tiers.coldLimit / count, tiers.spillFile.empty() ?
+			string() : tiers.spillFile + "." + to_string(i));
+		channels.push_back(Memory(0, channelSize, channelTiers));
+	}
+	if (tiers.tiered() && tiers.spillFile.empty() && tiers.coldLimit) {
+		cerr << "Without a spill file cold pages are not capped" << endl;
+	}
+}
+
+void GlobalMemory::reportTiers() const
+{
+	for (unsigned long i = 0; i < channels.size(); i++) {
+		channels[i].reportTiers("Block " + to_string(i));
+	}
+}
+
+//where address sits inside its channel
+uint64_t GlobalMemory::channelAddress(const uint64_t& address) const
+{
+	const uint64_t granule = address >> granuleShift;
+	const uint64_t row = shiftChannels ? granule >> channelShift :
+		granule / channels.size();
+	return (row << granuleShift) |
+		(address & ((1UL << granuleShift) - 1));
+}
+
+//how much of size bytes from address one channel holds
+uint64_t GlobalMemory::runLength(const uint64_t& address,
+	const uint64_t& size) const
+{
+	if (channels.size() == 1) {
+		return size;
+	}
+	const uint64_t toEdge = (1UL << granuleShift) -
+		(address & ((1UL << granuleShift) - 1));
+	return min(size, toEdge);
+}
+
+uint64_t GlobalMemory::checkRange(const uint64_t& address,
+	const uint64_t& size, const char *caller) const
+{
+	if (address + size > getSize() || address + size < address) {
+		cout << "GlobalMemory::" << caller << " out of range" << endl;
+		throw "Memory class range error";
+	}
+	return channelAddress(address);
+}
+
+//a word that straddles a granule goes to each channel a byte at a time
+void GlobalMemory::copyOut(uint64_t address, uint8_t *out, uint64_t size)
+{
+	for (uint64_t i = 0; i < size; i++) {
+		out[i] = channels[channelOf(address + i)].readByte(
+			channelAddress(address + i));
+	}
+}
+
+void GlobalMemory::copyIn(uint64_t address, const uint8_t *in,
+	uint64_t size)
+{
+	for (uint64_t i = 0; i < size; i++) {
+		channels[channelOf(address + i)].writeByte(
+			channelAddress(address + i), in[i]);
+	}
+}
+
+uint8_t GlobalMemory::readByte(const uint64_t& address)
+{
+	const uint64_t local = checkRange(address, sizeof(uint8_t),
+		"readByte");
+	return channels[channelOf(address)].readByte(local);
+}
+
+uint16_t GlobalMemory::readWord16(const uint64_t& address)
+{
+	const uint64_t local = checkRange(address, sizeof(uint16_t),
+		"readWord16");
+	if (oneChannel(address, sizeof(uint16_t))) {
+		return channels[channelOf(address)].readWord16(local);
+	}
+	uint16_t retVal;
+	copyOut(address, (uint8_t *)&retVal, sizeof(uint16_t));
+	return retVal;
+}
+
+uint32_t GlobalMemory::readWord32(const uint64_t& address)
+{
+	const uint64_t local = checkRange(address, sizeof(uint32_t),
+		"readWord32");
+	if (oneChannel(address, sizeof(uint32_t))) {
+		return channels[channelOf(address)].readWord32(local);
+	}
+	uint32_t retVal;
+	copyOut(address, (uint8_t *)&retVal, sizeof(uint32_t));
+	return retVal;
+}
+
+uint64_t GlobalMemory::readLong(const uint64_t& address)
+{
+	const uint64_t local = checkRange(address, sizeof(uint64_t),
+		"readLong");
+	if (oneChannel(address, sizeof(uint64_t))) {
+		return channels[channelOf(address)].readLong(local);
+	}
+	uint64_t retVal;
+	copyOut(address, (uint8_t *)&retVal, sizeof(uint64_t));
+	return retVal;
+}
+
+void GlobalMemory::writeByte(const uint64_t& address, const uint8_t& value)
+{
+	const uint64_t local = checkRange(address, sizeof(uint8_t),
+		"writeByte");
+	channels[channelOf(address)].writeByte(local, value);
+}
+
+void GlobalMemory::writeWord16(const uint64_t& address,
+	const uint16_t& value)
+{
+	const uint64_t local = checkRange(address, sizeof(uint16_t),
+		"writeWord16");
+	if (oneChannel(address, sizeof(uint16_t))) {
+		channels[channelOf(address)].writeWord16(local, value);
+		return;
+	}
+	copyIn(address, (const uint8_t *)&value, sizeof(uint16_t));
+}
+
+void GlobalMemory::writeWord32(const uint64_t& address,
+	const uint32_t& value)
+{
+	const uint64_t local = checkRange(address, sizeof(uint32_t),
+		"writeWord32");
+	if (oneChannel(address, sizeof(uint32_t))) {
+		channels[channelOf(address)].writeWord32(local, value);
+		return;
+	}
+	copyIn(address, (const uint8_t *)&value, sizeof(uint32_t));
+}
+
+void GlobalMemory::writeLong(const uint64_t& address, const uint64_t& value)
+{
+	const uint64_t local = checkRange(address, sizeof(uint64_t),
+		"writeLong");
+	if (oneChannel(address, sizeof(uint64_t))) {
+		channels[channelOf(address)].writeLong(local, value);
+		return;
+	}
+	copyIn(address, (const uint8_t *)&value, sizeof(uint64_t));
+}
+
+//a block is cut where it crosses from one channel to the next
+void GlobalMemory::readBlock(const uint64_t& address, uint8_t *out,
+	const uint64_t& size)
+{
+	checkRange(address, size, "readBlock");
+	uint64_t done = 0;
+	while (done < size) {
+		const uint64_t piece = runLength(address + done, size - done);
+		channels[channelOf(address + done)].readBlock(
+			channelAddress(address + done), out + done, piece);
+		done += piece;
+	}
+}
+
+void GlobalMemory::writeBlock(const uint64_t& address, const uint8_t *in,
+	const uint64_t& size)
+{
+	checkRange(address, size, "writeBlock");
+	uint64_t done = 0;
+	while (done < size) {
+		const uint64_t piece = runLength(address + done, size - done);
+		channels[channelOf(address + done)].writeBlock(
+			channelAddress(address + done), in + done, piece);
+		done += piece;
+	}
+}
+
+void GlobalMemory::fill(const uint64_t& address, const uint8_t& value,
+	const uint64_t& size)
+{
+	checkRange(address, size, "fill");
+	uint64_t done = 0;
+	while (done < size) {
+		const uint64_t piece = runLength(address + done, size - done);
+		channels[channelOf(address + done)].fill(
+			channelAddress(address + done), value, piece);
+		done += piece;
+	}
+}
@@ -1,31 +1,193 @@
 //Memory class
-#include <QMap>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 #ifndef _MEMORY_CLASS_
 #define _MEMORY_CLASS_
 
 const uint64_t PAGE_SHIFT = 10;
 
+//backing store is allocated a host page at a time, on first write
+const uint64_t CHUNK_SHIFT = 12;
+const uint64_t CHUNK_SIZE = 1 << CHUNK_SHIFT;
+//chunks per second level table
+const uint64_t TABLE_SHIFT = 9;
+//blocks this big are one anonymous mapping the kernel fills on demand
+const uint64_t MAP_THRESHOLD = 1 << 26;
+//blocks this small (tile scratchpads) are one cache line aligned array
+const uint64_t FLAT_LIMIT = 1 << 16;
+const uint64_t CACHE_LINE = 64;
+//unaligned writes lock the shard their chunk hashes to
+const uint64_t WRITE_SHARDS = 64;
+
 class Mux;
+class ColdStore;
+
+typedef std::atomic<uint8_t *> ChunkSlot;
 
+//caps for a tiered block - past hotLimit bytes the least recently used
+//chunks are compressed, past coldLimit compressed bytes the oldest go
+//to spillFile. No hotLimit, no tiers.
+class MemoryTiers {
+public:
+	uint64_t hotLimit;
+	uint64_t coldLimit;
+	std::string spillFile;
+	MemoryTiers(const uint64_t& hot = 0, const uint64_t& cold = 0,
+		const std::string& file = std::string()):
+		hotLimit(hot), coldLimit(cold), spillFile(file) {}
+	bool tiered() const { return hotLimit > 0; }
+};
+
+//Safe to share between tiles. Reads take no lock. A naturally aligned
+//byte, 16, 32 or 64 bit access is a single atomic load or store -
+//stores release and loads acquire, so a tile that reads a word another
+//tile wrote also sees everything that tile wrote before it. Unaligned
+//writes are serialised per chunk but are not atomic as a whole, and a
+//racing unaligned read may see part of one.
+//A tiered block trades the lock free reads for a bounded footprint:
+//every access holds its chunk's shard lock, so a chunk can go cold
+//under nobody's feet.
 class Memory {
 
 private:
 	const uint64_t start;
 	const uint64_t memorySize;
-    QMap<uint64_t, uint8_t> contents;
+	//two level radix table of chunks - untouched chunks are null and
+	//both levels are published with a release store
+	std::atomic<ChunkSlot *> *directory;
+	uint64_t directorySize;
+	//or the whole block, when it is mapped or small
+	uint8_t *flat;
+	bool mapped;
+	std::mutex allocLock;
+	std::vector<std::mutex> writeShards;
+	//tiered blocks only - chunks in memory, swept by a clock hand,
+	//and the rest. A chunk's byte past CHUNK_SIZE is its referenced
+	//bit. Lock order is tierLock, then a shard.
+	ColdStore *coldStore;
+	uint64_t hotLimit;
+	std::vector<uint64_t> hotChunks;
+	uint64_t clockHand;
+	mutable std::mutex tierLock;
 	Mux* rootMux;
+	//bytes overwritten since undoBase, oldest first - lets a Time
+	//Warp rollback rewind the memory
+	bool keepingUndo;
+	uint64_t undoBase;
+	std::deque<std::pair<uint64_t, uint8_t>> undoLog;
+	mutable std::mutex undoLock;
+	void logUndo(const uint64_t& address, const uint64_t& size);
+	void checkRange(const uint64_t& address, const uint64_t& size,
+		const char *caller) const;
+	const uint8_t* chunkFor(const uint64_t& offset) const;
+	uint8_t* touchChunk(const uint64_t& offset);
+	uint8_t* pinChunk(const uint64_t& offset, const bool create,
+		std::unique_lock<std::mutex>& lck);
+	void makeRoom();
+	bool holdsChunk(const uint64_t& offset) const;
+	void load(uint64_t offset, uint8_t *out, uint64_t size) const;
+	void store(uint64_t offset, const uint8_t *in, uint64_t size);
+	void set(uint64_t offset, const uint8_t& value, uint64_t size);
+	void copyIn(const uint64_t& offset, const uint8_t *in,
+		const uint64_t& size);
+	void release();
 
 public:
-	Memory(const uint64_t& start, const uint64_t& size);
+	Memory(const uint64_t& start, const uint64_t& size,
+		const MemoryTiers& tiers = MemoryTiers());
+	Memory(Memory&& other) noexcept;
+	Memory(const Memory&) = delete;
+	Memory& operator=(const Memory&) = delete;
+	~Memory();
     uint8_t readByte(const uint64_t& address);
     uint64_t readLong(const uint64_t& address);
+    uint16_t readWord16(const uint64_t& address);
     uint32_t readWord32(const uint64_t& address);
+	void writeWord16(const uint64_t& address, const uint16_t& value);
 	void writeWord32(const uint64_t& address, const uint32_t& value);
 	void writeByte(const uint64_t& address, const uint8_t& value);
 	void writeLong(const uint64_t& address, const uint64_t& value);
+	//bulk copies - one range check, memcpy across chunks
+	void readBlock(const uint64_t& address, uint8_t *out,
+		const uint64_t& size);
+	void writeBlock(const uint64_t& address, const uint8_t *in,
+		const uint64_t& size);
+	void fill(const uint64_t& address, const uint8_t& value,
+		const uint64_t& size);
 	void attachTree(Mux* root);
     uint64_t getSize() const;
     bool inRange(const uint64_t& address) const;
+	void keepUndoLog() { keepingUndo = true; }
+	uint64_t undoMark() const;
+	void rewindTo(const uint64_t& mark);
+	void forgetBefore(const uint64_t& mark);
+	//snapshot images - offsets are from start, runs are host pages
+	void imageRuns(std::vector<std::pair<uint64_t, uint64_t>>& runs)
+		const;
+	void imageCopy(const uint64_t& offset, uint8_t *out,
+		const uint64_t& size) const { load(offset, out, size); }
+	void mapImage(const int fd, const uint64_t& fileOffset,
+		const uint8_t *data, const uint64_t& offset,
+		const uint64_t& size);
+	void reportTiers(const std::string& name) const;
+};
+
+//the global address space - each block is a channel with its own Mux
+//tree, and the channels take turns every granule bytes
+class GlobalMemory {
+
+private:
+	std::vector<Memory> channels;
+	const uint64_t channelSize;
+	const uint64_t granuleShift;
+	//a power of two channel count divides by shifting
+	uint64_t channelShift;
+	bool shiftChannels;
+	uint64_t checkRange(const uint64_t& address, const uint64_t& size,
+		const char *caller) const;
+	bool oneChannel(const uint64_t& address, const uint64_t& size) const
+		{ return ((address & ((1UL << granuleShift) - 1)) + size) <=
+			(1UL << granuleShift); }
+	void copyOut(uint64_t address, uint8_t *out, uint64_t size);
+	void copyIn(uint64_t address, const uint8_t *in, uint64_t size);
+
+public:
+	GlobalMemory(const unsigned long count, const uint64_t& size,
+		const uint64_t& shift, const MemoryTiers& tiers = MemoryTiers());
+	unsigned long channelCount() const { return channels.size(); }
+	Memory& channel(const unsigned long index)
+		{ return channels[index]; }
+	unsigned long channelOf(const uint64_t& address) const {
+		const uint64_t granule = address >> granuleShift;
+		return shiftChannels ?
+			granule & ((1UL << channelShift) - 1) :
+			granule % channels.size();
+	}
+	uint64_t channelAddress(const uint64_t& address) const;
+	uint64_t runLength(const uint64_t& address,
+		const uint64_t& size) const;
+	uint64_t getSize() const { return channelSize * channels.size(); }
+	bool inRange(const uint64_t& address) const
+		{ return address < getSize(); }
+	uint8_t readByte(const uint64_t& address);
+	uint16_t readWord16(const uint64_t& address);
+	uint32_t readWord32(const uint64_t& address);
+	uint64_t readLong(const uint64_t& address);
+	void writeByte(const uint64_t& address, const uint8_t& value);
+	void writeWord16(const uint64_t& address, const uint16_t& value);
+	void writeWord32(const uint64_t& address, const uint32_t& value);
+	void writeLong(const uint64_t& address, const uint64_t& value);
+	void readBlock(const uint64_t& address, uint8_t *out,
+		const uint64_t& size);
+	void writeBlock(const uint64_t& address, const uint8_t *in,
+		const uint64_t& size);
+	void fill(const uint64_t& address, const uint8_t& value,
+		const uint64_t& size);
+	void reportTiers() const;
 };
 
 #endif
@@ -0,0 +1,188 @@
+//memorybench - compare the byte at a time and single copy word accessors
+//on normaliseLine's loads and stores
+//build: g++ -std=c++11 -O2 -I/usr/include/qt4 -I/usr/include/qt4/QtCore
+//	-o memorybench memorybench.cpp memory.cpp coldstore.cpp -lQtCore -lpthread
+
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include "memory.hpp"
+
+using namespace std;
+
+//as noc.hpp and ProcessorFunctor have them
+static const uint64_t AP_NUMBER_SIZE = 8;
+static const uint64_t SUM_COUNT = 0x101;
+static const uint64_t NUMBER_WORDS = AP_NUMBER_SIZE * 2 + 1;
+static const uint64_t LINE_BYTES = NUMBER_WORDS * SUM_COUNT *
+	sizeof(uint64_t);
+
+//words put together from readByte and writeByte, a range check a byte,
+//as Memory and Tile did before they got word accessors
+class ByteWords {
+public:
+	static uint64_t readLong(Memory& memory, const uint64_t& address)
+	{
+		uint64_t result = 0;
+		for (int i = sizeof(uint64_t) - 1; i >= 0; i--) {
+			result = (result << 8) | memory.readByte(address + i);
+		}
+		return result;
+	}
+
+	static void writeLong(Memory& memory, const uint64_t& address,
+		const uint64_t& value)
+	{
+		for (uint64_t i = 0; i < sizeof(uint64_t); i++) {
+			memory.writeByte(address + i, (value >> (i * 8)) & 0xFF);
+		}
+	}
+
+	static uint32_t readWord32(Memory& memory, const uint64_t& address)
+	{
+		uint32_t result = 0;
+		for (int i = 3; i >= 0; i--) {
+			result = (result << 8) | memory.readByte(address + i);
+		}
+		return result;
+	}
+
+	static void writeWord32(Memory& memory, const uint64_t& address,
+		const uint32_t& value)
+	{
+		for (int i = 0; i < 4; i++) {
+			memory.writeByte(address + i, (value >> (i * 8)) & 0xFF);
+		}
+	}
+};
+
+class CopyWords {
+public:
+	static uint64_t readLong(Memory& memory, const uint64_t& address)
+		{ return memory.readLong(address); }
+	static void writeLong(Memory& memory, const uint64_t& address,
+		const uint64_t& value) { memory.writeLong(address, value); }
+	static uint32_t readWord32(Memory& memory, const uint64_t& address)
+		{ return memory.readWord32(address); }
+	static void writeWord32(Memory& memory, const uint64_t& address,
+		const uint32_t& value) { memory.writeWord32(address, value); }
+};
+
+//one pass of normaliseLine over a line - flip each number's sign and
+//scale its numerator and denominator by the first number's
+template <typename W> uint64_t normalise(Memory& memory,
+	const uint64_t& line)
+{
+	const uint64_t first = line;
+	const uint64_t sign = W::readLong(memory, first) & 0xFF;
+	const uint64_t numerator = W::readLong(memory, first +
+		sizeof(uint64_t));
+	const uint64_t denominator = W::readLong(memory, first +
+		(AP_NUMBER_SIZE + 1) * sizeof(uint64_t));
+	W::writeLong(memory, first + sizeof(uint64_t), 1);
+	W::writeLong(memory, first + (AP_NUMBER_SIZE + 1) *
+		sizeof(uint64_t), 1);
+	uint64_t sum = 0;
+	for (uint64_t i = 1; i < SUM_COUNT; i++) {
+		const uint64_t number = line + i * NUMBER_WORDS *
+			sizeof(uint64_t);
+		uint64_t word = W::readLong(memory, number);
+		word = (word & 0xFFFFFFFFFFFFFF00) | ((word ^ sign) & 0xFF);
+		W::writeLong(memory, number, word);
+		const uint64_t top = number + sizeof(uint64_t);
+		const uint64_t bottom = number + (AP_NUMBER_SIZE + 1) *
+			sizeof(uint64_t);
+		word = W::readLong(memory, top);
+		W::writeLong(memory, top, word * denominator);
+		word = W::readLong(memory, bottom);
+		W::writeLong(memory, bottom, word * numerator);
+		sum += word;
+	}
+	return sum;
+}
+
+//page table and bitmap style 32 bit reads, with a write every eighth
+template <typename W> uint64_t walkTable(Memory& memory,
+	const uint64_t& base)
+{
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < LINE_BYTES / sizeof(uint32_t); i++) {
+		const uint64_t address = base + i * sizeof(uint32_t);
+		const uint32_t entry = W::readWord32(memory, address);
+		sum += entry;
+		if ((i & 7) == 0) {
+			W::writeWord32(memory, address, entry | 1);
+		}
+	}
+	return sum;
+}
+
+template <typename W> double linesPerSecond(Memory& memory,
+	const uint64_t& lines, const long passes, uint64_t& check)
+{
+	auto begin = chrono::steady_clock::now();
+	for (long pass = 0; pass < passes; pass++) {
+		for (uint64_t line = 0; line < lines; line++) {
+			check += normalise<W>(memory, line * LINE_BYTES);
+		}
+	}
+	chrono::duration<double> elapsed =
+		chrono::steady_clock::now() - begin;
+	return lines * passes / elapsed.count();
+}
+
+template <typename W> double tablesPerSecond(Memory& memory,
+	const uint64_t& lines, const long passes, uint64_t& check)
+{
+	auto begin = chrono::steady_clock::now();
+	for (long pass = 0; pass < passes; pass++) {
+		for (uint64_t line = 0; line < lines; line++) {
+			check += walkTable<W>(memory, line * LINE_BYTES);
+		}
+	}
+	chrono::duration<double> elapsed =
+		chrono::steady_clock::now() - begin;
+	return lines * passes / elapsed.count();
+}
+
+void fillLines(Memory& memory, const uint64_t& lines)
+{
+	for (uint64_t i = 0; i < lines * LINE_BYTES / sizeof(uint64_t); i++) {
+		memory.writeLong(i * sizeof(uint64_t), i * 2 + 1);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	long passes = 20;
+	if (argc > 1) {
+		passes = atol(argv[1]);
+	}
+	//a chunked block and one big enough to be mapped whole
+	const uint64_t sizes[] = {16 * 1024 * 1024, 128 * 1024 * 1024};
+	const string kinds[] = {"chunked", "mapped"};
+	const uint64_t lines = 256;
+	uint64_t check = 0;
+	cout << "Block, routine, byte lines/s, copy lines/s, speedup" << endl;
+	for (int i = 0; i < 2; i++) {
+		Memory memory(0, sizes[i]);
+		fillLines(memory, lines);
+		double bytes = linesPerSecond<ByteWords>(memory, lines, passes,
+			check);
+		double copies = linesPerSecond<CopyWords>(memory, lines, passes,
+			check);
+		cout << kinds[i] << ", normaliseLine, " << bytes << ", ";
+		cout << copies << ", " << copies / bytes << endl;
+		bytes = tablesPerSecond<ByteWords>(memory, lines, passes, check);
+		copies = tablesPerSecond<CopyWords>(memory, lines, passes, check);
+		cout << kinds[i] << ", 32 bit table, " << bytes << ", ";
+		cout << copies << ", " << copies / bytes << endl;
+	}
+	//keeps the loops from being optimised away
+	cerr << "check " << check << endl;
+}
@@ -2,7 +2,8 @@
 #include <vector>
 #include "memorypacket.hpp"
 
+//a byte at a time, in order - for answers that cannot be read as a block
 void MemoryPacket::fillBuffer(const uint8_t byte)
 {
-	payload.push_back(byte);
+	destination[fulfilSize++] = byte;
 }
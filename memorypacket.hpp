@@ -2,6 +2,7 @@
 #define __MPACKET_HPP_
 
 class Processor;
+class ParkedTile;
 
 class MemoryPacket {
 private:
@@ -10,14 +11,40 @@ private:
 	const uint64_t remoteAddress;
 	const uint64_t localAddress;
 	const uint64_t requestSize;
-	std::vector<uint8_t> payload;
+	//where the answer lands - the requester's buffer, so nothing is
+	//copied on the way. Null when nobody wants the data back
+	uint8_t * const destination;
 	enum direction{OUT, IN} pd;
+	//set by the barrier when a two-phase request goes through
+	bool granted;
+	//a parked packet stays posted until granted or its tile has to be
+	//up - commits counted so the tile can catch its clock up
+	ParkedTile *parked;
+	uint64_t waitLimit;
+	uint64_t waited;
+	//tick we entered the tree - for arbiters that favour age
+	uint64_t issued;
+	//split transactions - the commits carry the packet, not its tile,
+	//and mark it done when the response reaches the leaf
+	bool split;
+	bool done;
+	uint64_t sentTick;
+	uint64_t trip;
+	//a blocking packet the DDR controller has finished with
+	bool served;
+	//commit that put it in the buffer it is in now
+	uint64_t arrived;
 
 public:
 	MemoryPacket(Processor *processor, const uint64_t& remoteAddr,
-		const uint64_t& localAddr, const uint64_t& sz):
-		processorIndex(processor), remoteAddress(remoteAddr),
-		localAddress(localAddr), requestSize(sz), pd(OUT)
+		const uint64_t& localAddr, const uint64_t& sz,
+		uint8_t *into = nullptr):
+		fulfilSize(0), processorIndex(processor),
+		remoteAddress(remoteAddr), localAddress(localAddr),
+		requestSize(sz), destination(into), pd(OUT),
+		granted(false), parked(nullptr), waitLimit(0), waited(0),
+		issued(0), split(false), done(false), sentTick(0), trip(0),
+		served(false), arrived(0)
 	{}
 
 	void switchDirection()
@@ -32,15 +59,47 @@ public:
 	}
 
 	void fillBuffer(const uint8_t byte);
+	//the whole answer was written straight into the destination
+	void filled() { fulfilSize = requestSize; }
     uint64_t getRequestSize() const
 	{ return requestSize; }
     uint64_t getfulfilSize() const
 	{ return fulfilSize; }
     uint64_t getRemoteAddress() const
 	{ return remoteAddress; }
+	uint64_t getLocalAddress() const { return localAddress; }
 	Processor* getProcessor() const
 	{ return processorIndex; }
-	const std::vector<uint8_t> getMemory() const { return payload; }
+	uint8_t* getDestination() const { return destination; }
+	const uint8_t* getMemory() const { return destination; }
+	void grant() { granted = true; }
+	bool isGranted() const { return granted; }
+	void park(ParkedTile *tile, const uint64_t& limit)
+		{ parked = tile; waitLimit = limit; waited = 0; }
+	void unpark() { parked = nullptr; }
+	ParkedTile* getParked() const { return parked; }
+	//a commit went by - true if that is the last one we sleep through
+	bool parkedTick() { return ++waited >= waitLimit || granted; }
+	uint64_t getWaited() const { return waited; }
+	void setIssued(const uint64_t& tick) { issued = tick; }
+	uint64_t getIssued() const { return issued; }
+	//barrier ticks - tile clocks can be a tick or so apart
+	void makeSplit(const uint64_t& tick) { split = true; sentTick = tick; }
+	bool isSplit() const { return split; }
+	void complete(const uint64_t& tick)
+		{ done = true; trip = tick + 1 - sentTick; }
+	bool isDone() const { return done; }
+	uint64_t getTrip() const { return trip; }
+	void serve() { served = true; }
+	bool isServed() const { return served; }
+	void setArrived(const uint64_t& tick) { arrived = tick; }
+	uint64_t getArrived() const { return arrived; }
+	bool takeGrant()
+	{
+		const bool wasGranted = granted;
+		granted = false;
+		return wasGranted;
+	}
 };
 
 #endif
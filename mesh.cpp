@@ -0,0 +1,159 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include "mainwindow.h"
+#include "ControlThread.hpp"
+#include "memorypacket.hpp"
+#include "mux.hpp"
+#include "memory.hpp"
+#include "noc.hpp"
+#include "tile.hpp"
+#include "mesh.hpp"
+
+using namespace std;
+
+//a link for each connection the Noc made between neighbours
+Mesh::Mesh(Noc& noc, const uint64_t& latency, const uint64_t& width):
+	linkLatency(latency),
+	linkWidth(width), inboxes(noc.getColumnCount() * noc.getRowCount()),
+	inboxLocks(noc.getColumnCount() * noc.getRowCount()), messages(0),
+	hops(0), transitTicks(0), blockedTicks(0)
+{
+	if (linkLatency == 0 || linkWidth == 0) {
+		cerr << "Mesh links need a latency and a width" << endl;
+		throw "Mesh link error";
+	}
+	const long tiles = noc.getColumnCount() * noc.getRowCount();
+	places.resize(tiles);
+	for (long i = 0; i < tiles; i++) {
+		Tile *tile = noc.tileAt(i);
+		places[tile->getOrder()] = pair<long, long>(tile->getColumn(),
+			tile->getRow());
+		orders[places[tile->getOrder()]] = tile->getOrder();
+	}
+	for (long i = 0; i < tiles; i++) {
+		Tile *tile = noc.tileAt(i);
+		for (auto neighbour: tile->getConnections()) {
+			links[pair<uint64_t, uint64_t>(tile->getOrder(),
+				orders.at(neighbour))] = 0;
+		}
+	}
+}
+
+//X first, then Y
+uint64_t Mesh::nextHop(const uint64_t& at, const uint64_t& to) const
+{
+	pair<long, long> place = places[at];
+	const pair<long, long>& target = places[to];
+	if (place.first != target.first) {
+		place.first += place.first < target.first ? 1 : -1;
+	} else {
+		place.second += place.second < target.second ? 1 : -1;
+	}
+	return orders.at(place);
+}
+
+//the head takes linkLatency a hop, waiting for buffers still held by
+//earlier messages - the tail is flits behind it
+void Mesh::route(MeshMessage& message)
+{
+	const uint64_t flits = max((uint64_t)1,
+		(message.words.size() * sizeof(uint64_t) + linkWidth - 1) /
+		linkWidth);
+	uint64_t at = message.sent;
+	uint64_t here = message.source;
+	while (here != message.destination) {
+		const uint64_t there = nextHop(here, message.destination);
+		auto link = links.find(pair<uint64_t, uint64_t>(here, there));
+		if (link == links.end()) {
+			cerr << "Mesh has no link from " << here << " to ";
+			cerr << there << endl;
+			throw "Mesh link error";
+		}
+		at += linkLatency;
+		if (link->second > at) {
+			blockedTicks += link->second - at;
+			at = link->second;
+		}
+		link->second = at + flits;
+		here = there;
+		hops++;
+	}
+	message.arrives = max(at + flits - 1, message.sent + 1);
+	messages++;
+	transitTicks += message.arrives - message.sent;
+}
+
+void Mesh::send(const uint64_t& source, const uint64_t& destination,
+	const uint64_t& tick, const vector<uint64_t>& words)
+{
+	if (destination >= places.size()) {
+		cerr << "Mesh message to tile " << destination;
+		cerr << " - there is no such tile" << endl;
+		throw "Mesh route error";
+	}
+	MeshMessage message;
+	message.source = source;
+	message.destination = destination;
+	message.sent = tick;
+	message.arrives = 0;
+	message.words = words;
+	unique_lock<mutex> lck(postLock);
+	posted.push_back(message);
+}
+
+//called by the barrier, no tile running - a tile's own sends keep the
+//order it made them in
+void Mesh::commit()
+{
+	unique_lock<mutex> lck(postLock);
+	if (posted.empty()) {
+		return;
+	}
+	stable_sort(posted.begin(), posted.end(),
+		[](const MeshMessage& a, const MeshMessage& b) {
+			return a.sent < b.sent ||
+				(a.sent == b.sent && a.source < b.source);
+		});
+	for (auto& message: posted) {
+		route(message);
+		unique_lock<mutex> inboxLck(inboxLocks[message.destination]);
+		inboxes[message.destination].push_back(message);
+	}
+	posted.clear();
+}
+
+//the first message to get to order by tick, if any has
+bool Mesh::receive(const uint64_t& order, const uint64_t& tick,
+	vector<uint64_t>& words)
+{
+	unique_lock<mutex> lck(inboxLocks[order]);
+	vector<MeshMessage>& inbox = inboxes[order];
+	auto first = inbox.end();
+	for (auto it = inbox.begin(); it != inbox.end(); it++) {
+		if (it->arrives <= tick &&
+			(first == inbox.end() || it->arrives < first->arrives)) {
+			first = it;
+		}
+	}
+	if (first == inbox.end()) {
+		return false;
+	}
+	words = first->words;
+	inbox.erase(first);
+	return true;
+}
+
+void Mesh::report() const
+{
+	if (messages == 0) {
+		return;
+	}
+	cout << "Mesh: " << messages << " messages, mean ";
+	cout << (double)hops / messages << " hops and ";
+	cout << (double)transitTicks / messages << " ticks, ";
+	cout << blockedTicks << " ticks waiting on busy links" << endl;
+}
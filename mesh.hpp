@@ -0,0 +1,62 @@
+//2D mesh between neighbouring tiles
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#ifndef _MESH_CLASS_
+#define _MESH_CLASS_
+
+//bytes a link carries a tick - a 128 bit flit
+static const uint64_t MESH_LINK_WIDTH = 16;
+
+class Noc;
+
+class MeshMessage {
+public:
+	uint64_t source;
+	uint64_t destination;
+	uint64_t sent;
+	uint64_t arrives;
+	std::vector<uint64_t> words;
+};
+
+//Dimension order routing - a message goes along its row (X) first,
+//then up or down its column (Y). Every neighbour link has an input
+//buffer a message holds for as many ticks as it has flits. Sends wait
+//for the barrier to route them, oldest and then lowest tile first, so
+//the order threads happen to run in cannot change who waits.
+class Mesh {
+
+private:
+	const uint64_t linkLatency;
+	const uint64_t linkWidth;
+	//tile order to column and row, and back
+	std::vector<std::pair<long, long>> places;
+	std::map<std::pair<long, long>, uint64_t> orders;
+	//tick each link's input buffer is next free, by sender, receiver
+	std::map<std::pair<uint64_t, uint64_t>, uint64_t> links;
+	std::mutex postLock;
+	std::vector<MeshMessage> posted;
+	std::vector<std::vector<MeshMessage>> inboxes;
+	std::vector<std::mutex> inboxLocks;
+	uint64_t messages;
+	uint64_t hops;
+	uint64_t transitTicks;
+	uint64_t blockedTicks;
+	uint64_t nextHop(const uint64_t& at, const uint64_t& to) const;
+	void route(MeshMessage& message);
+
+public:
+	Mesh(Noc& noc, const uint64_t& latency,
+		const uint64_t& width = MESH_LINK_WIDTH);
+	uint64_t tileCount() const { return places.size(); }
+	void send(const uint64_t& source, const uint64_t& destination,
+		const uint64_t& tick, const std::vector<uint64_t>& words);
+	void commit();
+	bool receive(const uint64_t& order, const uint64_t& tick,
+		std::vector<uint64_t>& words);
+	void report() const;
+};
+
+#endif
@@ -13,12 +13,19 @@
 #include "tile.hpp"
 #include "processor.hpp"
 #include "mux.hpp"
+#include "warp.hpp"
+#include "arbiter.hpp"
+#include "ddr.hpp"
+#include "coalesce.hpp"
+#include "muxstats.hpp"
+#include "wormhole.hpp"
 
 using namespace std;
 
 Mux::~Mux()
 {
 	disarmMutex();
+	delete arbiter;
 }
 
 void Mux::disarmMutex()
@@ -45,7 +52,8 @@ bool Mux::acceptPacketUp(const MemoryPacket& mPack) const
 		cerr << "Mux has no global memory assigned" << endl;
 		return false;
 	}
-	return (globalMemory->inRange(mPack.getRemoteAddress()));
+	return (globalMemory->inRange(mPack.getRemoteAddress()) &&
+		globalMemory->channelOf(mPack.getRemoteAddress()) == channel);
 }
 
 const tuple<const uint64_t, const uint64_t, const uint64_t,
@@ -55,14 +63,429 @@ const tuple<const uint64_t, const uint64_t, const uint64_t,
 		get<0>(lowerRight), get<1>(lowerRight));
 }
 
-void Mux::fillBottomBuffer(bool& buffer, mutex *botMutex,
+//strict mode always claims a buffer on the tick it is emptied or
+//the one after - anything later is quantum mode timing error
+void Mux::claimed(MemoryPacket& packet, const uint64_t& firstTry,
+	const uint64_t& freed) const
+{
+	const uint64_t now = packet.getProcessor()->getTicks();
+	const uint64_t strict = max(freed + 1, firstTry);
+	if (now > strict) {
+		packet.getProcessor()->getTile()->getBarrier()->
+			recordLateness(now - strict);
+	}
+}
+
+bool Mux::bufferEmpty(const bool& buffer, MemoryPacket& packet) const
+{
+	Processor *proc = packet.getProcessor();
+	TimeWarp *warp = proc->getTile()->getBarrier()->getWarp();
+	if (warp) {
+		return !warp->observe(&buffer, proc);
+	}
+	return !buffer;
+}
+
+bool Mux::bufferVacant(const bool& buffer, const uint64_t& freed,
+	MemoryPacket& packet) const
+{
+	Processor *proc = packet.getProcessor();
+	TimeWarp *warp = proc->getTile()->getBarrier()->getWarp();
+	if (warp) {
+		return !warp->observe(&buffer, proc);
+	}
+	return vacant(buffer, freed, proc->getTicks());
+}
+
+//buffer is one of ours
+void Mux::takeBuffer(bool& buffer, MemoryPacket& packet)
+{
+	Processor *proc = packet.getProcessor();
+	TimeWarp *warp = proc->getTile()->getBarrier()->getWarp();
+	if (warp) {
+		warp->modify(&buffer, proc, true);
+	} else {
+		buffer = true;
+	}
+	(&buffer == &leftBuffer ? leftIssued : rightIssued) =
+		packet.getIssued();
+}
+
+//only means anything when both buffers are full
+bool Mux::leftFirst() const
+{
+	return arbiter->leftFirst(leftIssued, rightIssued);
+}
+
+void Mux::freeBuffer(bool& buffer, uint64_t& freed, MemoryPacket& packet)
+{
+	Processor *proc = packet.getProcessor();
+	TimeWarp *warp = proc->getTile()->getBarrier()->getWarp();
+	if (warp) {
+		warp->modify(&buffer, proc, false);
+	} else {
+		buffer = false;
+		freed = proc->getTicks();
+	}
+}
+
+//fill the packet from DDR - Time Warp has to see every word read
+void Mux::readGlobal(MemoryPacket& packet) const
+{
+	Processor *proc = packet.getProcessor();
+	TimeWarp *warp = proc->getTile()->getBarrier()->getWarp();
+	const uint64_t address = packet.getRemoteAddress();
+	const uint64_t size = packet.getRequestSize();
+	if (warp) {
+		//the reads are tracked for rollback, wanted or not
+		for (uint64_t i = 0; i < size; i++) {
+			const uint8_t byte = warp->readByte(proc, address + i);
+			if (packet.getDestination()) {
+				packet.fillBuffer(byte);
+			}
+		}
+		return;
+	}
+	//a write back - nobody wants what is there
+	if (packet.getDestination() == nullptr) {
+		return;
+	}
+	proc->getTile()->readBlock(address, packet.getDestination(), size);
+	packet.filled();
+}
+
+bool Mux::twoPhase(MemoryPacket& packet) const
+{
+	return packet.getProcessor()->getTile()->getBarrier()->isTwoPhase();
+}
+
+//post the request until the barrier grants it - parked, the request
+//stays posted and the commit that grants it wakes us on that tick
+void Mux::awaitGrant(MemoryPacket *& slot, MemoryPacket& packet)
+{
+	Processor *proc = packet.getProcessor();
+	while (true) {
+		slot = &packet;
+		if (!proc->parkForHandoff(packet)) {
+			proc->waitGlobalTick();
+		}
+		if (packet.takeGrant()) {
+			return;
+		}
+		proc->incrementBlocks();
+	}
+}
+
+//end of a commit for a posted packet - a parked one that wasn't granted
+//stays posted and the block is charged for it, until its tile has to
+//be up for a CLOCK
+void Mux::settle(MemoryPacket *& slot)
+{
+	MemoryPacket *packet = slot;
+	slot = nullptr;
+	//a split packet has no tile to post it again - it stays
+	if (packet->isSplit()) {
+		if (!packet->takeGrant()) {
+			packet->getProcessor()->getTile()->getBarrier()->
+				incrementBlocks();
+			slot = packet;
+		}
+		return;
+	}
+	ParkedTile *parked = packet->getParked();
+	if (!parked) {
+		return;
+	}
+	ControlThread *barrier = packet->getProcessor()->getTile()->
+		getBarrier();
+	if (packet->parkedTick()) {
+		packet->unpark();
+		barrier->wakeTile(*parked);
+		return;
+	}
+	barrier->incrementBlocks();
+	slot = packet;
+}
+
+//move the packet in buffer on up the tree (or off to DDR at the root) -
+//a split packet is posted above for the next commit, or waits on DDR
+void Mux::moveOn(bool& buffer, MemoryPacket *& request, const bool& left,
+	const uint64_t& tick)
+{
+	bool *target = nullptr;
+	uint64_t *issued = nullptr;
+	MemoryPacket **above = nullptr;
+	if (upstreamMux) {
+		const bool targetLeft =
+			lowerLeft.first <= upstreamMux->lowerLeft.second;
+		target = targetLeft ? &upstreamMux->leftBuffer :
+			&upstreamMux->rightBuffer;
+		issued = targetLeft ? &upstreamMux->leftIssued :
+			&upstreamMux->rightIssued;
+		above = targetLeft ? &upstreamMux->leftRequest :
+			&upstreamMux->rightRequest;
+	}
+	if (target == nullptr || *target == false) {
+		buffer = false;
+		if (target) {
+			*target = true;
+			*issued = request->getIssued();
+		}
+		if (stats) {
+			stats[left ? 0 : 1].passed(tick - request->getArrived());
+		}
+		request->setArrived(tick);
+		request->grant();
+		arbiter->granted(left);
+		if (request->isSplit() && above) {
+			*above = request;
+		} else {
+			offToDDR(request, tick);
+		}
+	}
+}
+
+//out of the root - with a flat DDR a blocking packet's tile sleeps out
+//DDR_DELAY itself, unless flits have to carry the answer back
+void Mux::offToDDR(MemoryPacket *request, const uint64_t& tick)
+{
+	if (coalescer) {
+		coalescer->add(request, tick);
+	} else if (ddr) {
+		ddr->enqueue(request, tick);
+	} else if (request->isSplit() || wormhole) {
+		atDDR.push_back(pair<uint64_t, MemoryPacket *>(
+			tick + DDR_DELAY * GLOBALCLOCKSLOW, request));
+	}
+}
+
+//the head of a leaf's split queue takes the empty buffer - and asks to
+//move on at the next commit
+void Mux::enter(bool& buffer, uint64_t& issued, vector<MemoryPacket *>& queue,
+	MemoryPacket *& request, const uint64_t& tick)
+{
+	buffer = true;
+	issued = queue.front()->getIssued();
+	request = queue.front();
+	request->setArrived(tick);
+	queue.erase(queue.begin());
+}
+
+//grant this tick's requests - called with no tile running, root first,
+//so a buffer emptied above is free to the packet below on the same tick
+void Mux::commit(const uint64_t& tick)
+{
+	//with both buffers full the arbiter picks who goes first - the
+	//other only moves if that left the first side empty
+	const bool leftGoes = !rightBuffer || (leftBuffer && leftFirst());
+	if (leftGoes) {
+		if (leftRequest) {
+			moveOn(leftBuffer, leftRequest, true, tick);
+		}
+		if (rightRequest && !leftBuffer) {
+			moveOn(rightBuffer, rightRequest, false, tick);
+		}
+	} else {
+		if (rightRequest) {
+			moveOn(rightBuffer, rightRequest, false, tick);
+		}
+		if (leftRequest && !rightBuffer) {
+			moveOn(leftBuffer, leftRequest, true, tick);
+		}
+	}
+	blockedOn(true, leftRequest);
+	blockedOn(false, rightRequest);
+	if (leftRequest) {
+		settle(leftRequest);
+	}
+	if (rightRequest) {
+		settle(rightRequest);
+	}
+	if (leftFill) {
+		if (!leftBuffer) {
+			leftBuffer = true;
+			leftIssued = leftFill->getIssued();
+			leftFill->setArrived(tick);
+			leftFill->grant();
+		}
+		blockedOn(true, leftFill);
+		settle(leftFill);
+	} else if (!leftQueue.empty() && !leftBuffer) {
+		enter(leftBuffer, leftIssued, leftQueue, leftRequest, tick);
+	}
+	if (rightFill) {
+		if (!rightBuffer) {
+			rightBuffer = true;
+			rightIssued = rightFill->getIssued();
+			rightFill->setArrived(tick);
+			rightFill->grant();
+		}
+		blockedOn(false, rightFill);
+		settle(rightFill);
+	} else if (!rightQueue.empty() && !rightBuffer) {
+		enter(rightBuffer, rightIssued, rightQueue, rightRequest,
+			tick);
+	}
+	if (stats) {
+		stats[0].full += leftBuffer;
+		stats[1].full += rightBuffer;
+		stats[0].blocked += leftQueue.size();
+		stats[1].blocked += rightQueue.size();
+	}
+}
+
+//a packet posted on a side that this commit did not grant waited a tick
+void Mux::blockedOn(const bool& left, const MemoryPacket *packet)
+{
+	if (stats && packet && !packet->isGranted()) {
+		stats[left ? 0 : 1].blocked++;
+	}
+}
+
+bool Mux::leftOf(const MemoryPacket& packet) const
+{
+	return packet.getProcessor()->getTile()->getOrder() <
+		lowerRight.first;
+}
+
+//drop a response a level - at a leaf it is home
+void Mux::respond(MemoryPacket *& response, const uint64_t& tick)
+{
+	if (response == nullptr) {
+		return;
+	}
+	Mux *below = (&response == &leftResponse) ? downstreamMuxLow :
+		downstreamMuxHigh;
+	if (below == nullptr) {
+		response->complete(tick);
+		response->getProcessor()->getTile()->getBarrier()->
+			packetLanded();
+		response = nullptr;
+		return;
+	}
+	MemoryPacket *& next = below->leftOf(*response) ?
+		below->leftResponse : below->rightResponse;
+	if (next == nullptr) {
+		next = response;
+		response = nullptr;
+	}
+}
+
+//DDR has the data - for each request a burst stood for, a split one
+//goes back down the tree and a blocking one's tile can read it
+void Mux::answer(MemoryPacket *packet, const uint64_t& tick)
+{
+	vector<MemoryPacket *> members;
+	if (coalescer) {
+		coalescer->fanOut(packet, members);
+	} else {
+		members.push_back(packet);
+	}
+	for (auto member: members) {
+		if (member->isSplit() || wormhole) {
+			atDDR.push_back(pair<uint64_t, MemoryPacket *>(tick,
+				member));
+		} else {
+			member->serve();
+		}
+	}
+}
+
+//second pass of a commit, leaves first, so a response buffer emptied
+//below is free to the one above on the same tick. The root takes DDR's
+//answers in the order they were asked for - or, with a controller, in
+//the order it gets through them
+void Mux::commitDown(const uint64_t& tick)
+{
+	respond(leftResponse, tick);
+	respond(rightResponse, tick);
+	if (coalescer) {
+		vector<MemoryPacket *> closed;
+		coalescer->close(tick, closed);
+		for (auto burst: closed) {
+			if (ddr) {
+				ddr->enqueue(burst, tick);
+			} else {
+				bursts.push_back(pair<uint64_t, MemoryPacket *>(
+					tick + DDR_DELAY * GLOBALCLOCKSLOW,
+					burst));
+			}
+		}
+		while (!bursts.empty() && bursts.front().first <= tick) {
+			answer(bursts.front().second, tick);
+			bursts.erase(bursts.begin());
+		}
+	}
+	if (ddr) {
+		vector<MemoryPacket *> served;
+		ddr->tick(tick, served);
+		for (auto packet: served) {
+			answer(packet, tick);
+		}
+	}
+	while (!atDDR.empty() && atDDR.front().first <= tick) {
+		MemoryPacket *packet = atDDR.front().second;
+		if (wormhole) {
+			readGlobal(*packet);
+			wormhole->respond(packet, tick);
+			atDDR.erase(atDDR.begin());
+			continue;
+		}
+		MemoryPacket *& response = leftOf(*packet) ? leftResponse :
+			rightResponse;
+		if (response) {
+			return;
+		}
+		readGlobal(*packet);
+		response = packet;
+		atDDR.erase(atDDR.begin());
+	}
+}
+
+//queue a split packet at its leaf - the tile does not wait for it here
+void Mux::injectPacket(MemoryPacket& packet, const bool& left)
+{
+	packet.setIssued(packet.getProcessor()->getTicks());
+	packet.getProcessor()->getTile()->getBarrier()->packetSent();
+	if (wormhole) {
+		wormhole->post(&packet);
+		return;
+	}
+	if (left) {
+		leftQueue.push_back(&packet);
+	} else {
+		rightQueue.push_back(&packet);
+	}
+}
+
+//flits all the way - the root reads the answer as DDR gives it, and it
+//is ours once its last flit is in
+void Mux::sendFlits(MemoryPacket& packet)
+{
+	wormhole->post(&packet);
+	while (!packet.isServed()) {
+		packet.getProcessor()->waitGlobalTick();
+	}
+}
+
+void Mux::fillBottomBuffer(bool& buffer, uint64_t& freed, mutex *botMutex,
 	MemoryPacket& packet)
 {
+	if (twoPhase(packet)) {
+		return awaitGrant(&buffer == &leftBuffer ? leftFill : rightFill,
+			packet);
+	}
+	uint64_t firstTry = 0;
 	while (true) {
 		packet.getProcessor()->waitGlobalTick();
+		const uint64_t now = packet.getProcessor()->getTicks();
+		if (firstTry == 0) {
+			firstTry = now;
+		}
 		botMutex->lock();
-		if (buffer == false) {
-			buffer = true;
+		if (bufferVacant(buffer, freed, packet)) {
+			takeBuffer(buffer, packet);
+			claimed(packet, firstTry, freed);
 			botMutex->unlock();
 			return;
 		}
@@ -71,29 +494,39 @@ void Mux::fillBottomBuffer(bool& buffer, mutex *botMutex,
 	}
 }
 
-void Mux::routeDown(MemoryPacket& packet)
+void Mux::routeDown(MemoryPacket& packet, const bool& packetOnLeft)
 {
 	//packet is ready to traverse to DDR, but is DDR free
-	//and, again, may only shift from right if left is empty
-	// are we left or right?
-	bool packetOnLeft = false;
-	const uint64_t processorIndex = packet.getProcessor()->
-		getTile()->getOrder();
-	if (processorIndex < lowerRight.first) {
-		packetOnLeft = true;
+	//and, again, may only shift if the other side is empty or the
+	//arbiter puts us first
+	if (twoPhase(packet)) {
+		awaitGrant(packetOnLeft ? leftRequest : rightRequest, packet);
+		if (ddr || coalescer) {
+			//the root says when our data is through
+			while (!packet.isServed()) {
+				packet.getProcessor()->waitGlobalTick();
+			}
+			readGlobal(packet);
+			return;
+		}
+		goto fillDDR;
 	}
 	while (true) {
 		packet.getProcessor()->waitGlobalTick();
 		bottomLeftMutex->lock();
 		bottomRightMutex->lock();
 		if (packetOnLeft) {
-			leftBuffer = false;
-			bottomRightMutex->unlock();
-			bottomLeftMutex->unlock();
-			goto fillDDR;
+			if (leftFirst() || bufferEmpty(rightBuffer, packet)) {
+				freeBuffer(leftBuffer, leftFreed, packet);
+				arbiter->granted(true);
+				bottomRightMutex->unlock();
+				bottomLeftMutex->unlock();
+				goto fillDDR;
+			}
 		} else {
-			if (!leftBuffer) {
-				rightBuffer = false;
+			if (bufferEmpty(leftBuffer, packet) || !leftFirst()) {
+				freeBuffer(rightBuffer, rightFreed, packet);
+				arbiter->granted(false);
 				bottomRightMutex->unlock();
 				bottomLeftMutex->unlock();
 				goto fillDDR;
@@ -107,90 +540,108 @@ void Mux::routeDown(MemoryPacket& packet)
 fillDDR:
 
 	//cross to DDR and wait average time (DDR_DELAY)
-	for (unsigned int i = 0; i < DDR_DELAY; i++) {
-		packet.getProcessor()->waitGlobalTick();
-	}
+	packet.getProcessor()->sleepFor(DDR_DELAY * GLOBALCLOCKSLOW);
 	//get memory
-	for (unsigned int i = 0; i < packet.getRequestSize(); i++) {
-		packet.fillBuffer(packet.getProcessor()->
-			getTile()->readByte(packet.getRemoteAddress() + i));
-	}
+	readGlobal(packet);
 	return;
 }	
 
-void Mux::keepRoutingPacket(MemoryPacket& packet)
-{
-	if (upstreamMux == nullptr) {
-		return routeDown(packet);
-	} else {
-		return postPacketUp(packet);
-	}
-}
-
-void Mux::postPacketUp(MemoryPacket& packet)
+//move the packet from our buffer on its side to the one it takes in
+//the Mux above - the tree walks it on from there
+void Mux::postPacketUp(MemoryPacket& packet, const bool& left,
+	Mux& upstream, const bool& upstreamLeft)
 {
-	//one method here allows us to vary priorities between left and right
+	//one method here - the Mux's arbiter varies priorities between
+	//left and right
 	//first step - what is the buffer we are targetting
-	const uint64_t processorIndex = packet.getProcessor()->
-		getTile()->getOrder();
-	mutex *targetMutex = upstreamMux->bottomRightMutex;
-	bool targetOnRight = true;
-	if (processorIndex <= upstreamMux->lowerLeft.second) {
-		targetOnRight = false;
-		targetMutex = upstreamMux->bottomLeftMutex;
+	const bool targetOnRight = !upstreamLeft;
+	mutex *targetMutex = targetOnRight ? upstream.bottomRightMutex :
+		upstream.bottomLeftMutex;
+	const uint64_t& targetFreed = targetOnRight ?
+		upstream.rightFreed : upstream.leftFreed;
+	uint64_t firstTry = 0;
+	if (twoPhase(packet)) {
+		return awaitGrant(left ? leftRequest : rightRequest, packet);
 	}
 
 	while (true) {
 		packet.getProcessor()->waitGlobalTick();
-		//left always priority in this implementation
+		const uint64_t now = packet.getProcessor()->getTicks();
+		if (firstTry == 0) {
+			firstTry = now;
+		}
+		//the other side has to be empty unless the arbiter puts us
+		//first
 		bottomLeftMutex->lock();
 		bottomRightMutex->lock();
 		//which are we, left or right?
-		if ((processorIndex < lowerRight.first) && leftBuffer) {
-			targetMutex->lock();
-			if (targetOnRight && upstreamMux->rightBuffer == false)
-			{
-				leftBuffer = false;
-				upstreamMux->rightBuffer = true;
-				targetMutex->unlock();
-				bottomRightMutex->unlock();
-				bottomLeftMutex->unlock();
-				return upstreamMux->keepRoutingPacket(packet);
-			}
-			else if (!targetOnRight &&
-				upstreamMux->leftBuffer == false)
-			{
-				leftBuffer = false;
-				upstreamMux->leftBuffer = true;
+		if (left && !bufferEmpty(leftBuffer, packet)) {
+			if (leftFirst() || bufferEmpty(rightBuffer, packet)) {
+				targetMutex->lock();
+				if (targetOnRight &&
+					bufferVacant(upstream.rightBuffer,
+					upstream.rightFreed, packet))
+				{
+					freeBuffer(leftBuffer, leftFreed, packet);
+					arbiter->granted(true);
+					upstream.takeBuffer(
+						upstream.rightBuffer, packet);
+					claimed(packet, firstTry, targetFreed);
+					targetMutex->unlock();
+					bottomRightMutex->unlock();
+					bottomLeftMutex->unlock();
+					return;
+				}
+				else if (!targetOnRight &&
+					bufferVacant(upstream.leftBuffer,
+					upstream.leftFreed, packet))
+				{
+					freeBuffer(leftBuffer, leftFreed, packet);
+					arbiter->granted(true);
+					upstream.takeBuffer(
+						upstream.leftBuffer, packet);
+					claimed(packet, firstTry, targetFreed);
+					targetMutex->unlock();
+					bottomRightMutex->unlock();
+					bottomLeftMutex->unlock();
+					return;
+				}
 				targetMutex->unlock();
-				bottomRightMutex->unlock();
-				bottomLeftMutex->unlock();
-				return upstreamMux->keepRoutingPacket(packet);
 			}
-			targetMutex->unlock();
 		} else {
-			//can only proceed on right if left is empty
-			if (!leftBuffer) {
+			if (bufferEmpty(leftBuffer, packet) || !leftFirst()) {
 				targetMutex->lock();
 				if (targetOnRight &&
-					upstreamMux->rightBuffer == false)
+					bufferVacant(upstream.rightBuffer,
+					upstream.rightFreed, packet))
 				{
-					rightBuffer = false;
-					upstreamMux->rightBuffer = true;
+					freeBuffer(rightBuffer, rightFreed,
+						packet);
+					arbiter->granted(false);
+					upstream.takeBuffer(
+						upstream.rightBuffer, packet);
+					claimed(packet, firstTry,
+						targetFreed);
 					targetMutex->unlock();
 					bottomRightMutex->unlock();
 					bottomLeftMutex->unlock();
-					return upstreamMux->keepRoutingPacket(packet);
+					return;
 				}
 				else if (!targetOnRight &&
-					upstreamMux->leftBuffer == false)
+					bufferVacant(upstream.leftBuffer,
+					upstream.leftFreed, packet))
 				{
-					rightBuffer = false;
-					upstreamMux->leftBuffer = true;
+					freeBuffer(rightBuffer, rightFreed,
+						packet);
+					arbiter->granted(false);
+					upstream.takeBuffer(
+						upstream.leftBuffer, packet);
+					claimed(packet, firstTry,
+						targetFreed);
 					targetMutex->unlock();
 					bottomRightMutex->unlock();
 					bottomLeftMutex->unlock();
-					return upstreamMux->keepRoutingPacket(packet);
+					return;
 				}
 				targetMutex->unlock();
 			}
@@ -201,19 +652,16 @@ void Mux::postPacketUp(MemoryPacket& packet)
 	}
 }
 
-void Mux::routePacket(MemoryPacket& packet)
+//into one of a leaf's buffers
+void Mux::enterLeaf(MemoryPacket& packet, const bool& left)
 {
-	const uint64_t processorIndex = packet.getProcessor()->
-		getTile()->getOrder();
-	if (processorIndex >= lowerLeft.first &&
-		processorIndex <= lowerLeft.second) {
-		fillBottomBuffer(leftBuffer, bottomLeftMutex,
+	if (left) {
+		fillBottomBuffer(leftBuffer, leftFreed, bottomLeftMutex,
 			packet);
 	} else {
-		fillBottomBuffer(rightBuffer, bottomRightMutex,
+		fillBottomBuffer(rightBuffer, rightFreed, bottomRightMutex,
 			packet);
 	}
-	return postPacketUp(packet);
 }
 
 void Mux::joinUpMux(const Mux& left, const Mux& right)
@@ -4,43 +4,128 @@
 
 static const uint64_t DDR_DELAY = 30;
 
-class Memory;
+class GlobalMemory;
+class Arbiter;
+class DDRController;
+class Coalescer;
+class SideStats;
+class Wormhole;
 
-class Mux {
+//a cache line or more each, so tiles busy in neighbouring Muxes do not
+//share one
+class alignas(64) Mux {
 private:
-	Memory* globalMemory;
+	GlobalMemory* globalMemory;
+	//the memory channel this Mux's tree serves
+	unsigned long channel;
 	std::pair<uint64_t, uint64_t> lowerLeft;
 	std::pair<uint64_t, uint64_t> lowerRight;
 	bool leftBuffer;
 	bool rightBuffer;
+	//tick each buffer was last emptied on - in quantum mode a buffer
+	//emptied in our future is still full for us
+	uint64_t leftFreed;
+	uint64_t rightFreed;
+	//tick the packet in each buffer entered the tree
+	uint64_t leftIssued;
+	uint64_t rightIssued;
+	//who goes first when both buffers are full
+	Arbiter *arbiter;
 	std::mutex *bottomLeftMutex;
 	std::mutex *bottomRightMutex;
+	//two-phase tick - packets post what they want during the tick and
+	//the barrier grants it all at once, so host order cannot matter
+	MemoryPacket *leftRequest;
+	MemoryPacket *rightRequest;
+	MemoryPacket *leftFill;
+	MemoryPacket *rightFill;
+	//split transactions - a tile queues them at its leaf, the commits
+	//carry them up and DDR's answers come back down through buffers of
+	//their own
+	std::vector<MemoryPacket *> leftQueue;
+	std::vector<MemoryPacket *> rightQueue;
+	MemoryPacket *leftResponse;
+	MemoryPacket *rightResponse;
+	std::vector<std::pair<uint64_t, MemoryPacket *>> atDDR;
+	//the root's DDR controller - null for a flat DDR_DELAY
+	DDRController *ddr;
+	//the root's coalescing stage, and its bursts out at a flat DDR
+	Coalescer *coalescer;
+	std::vector<std::pair<uint64_t, MemoryPacket *>> bursts;
+	//left then right, kept by the tree - null when nobody is counting
+	SideStats *stats;
+	//flits in place of whole packets - null when the Muxes carry them
+	Wormhole *wormhole;
 	void disarmMutex();
+	static bool vacant(const bool& buffer, const uint64_t& freed,
+		const uint64_t& tick)
+		{ return buffer == false && freed <= tick; }
+	void claimed(MemoryPacket& packet, const uint64_t& firstTry,
+		const uint64_t& freed) const;
+	//buffer access - under Time Warp the flags are event histories
+	bool bufferEmpty(const bool& buffer, MemoryPacket& packet) const;
+	bool bufferVacant(const bool& buffer, const uint64_t& freed,
+		MemoryPacket& packet) const;
+	void takeBuffer(bool& buffer, MemoryPacket& packet);
+	bool leftFirst() const;
+	void freeBuffer(bool& buffer, uint64_t& freed, MemoryPacket& packet);
+	void readGlobal(MemoryPacket& packet) const;
+	bool twoPhase(MemoryPacket& packet) const;
+	void awaitGrant(MemoryPacket *& slot, MemoryPacket& packet);
+	void moveOn(bool& buffer, MemoryPacket *& request, const bool& left,
+		const uint64_t& tick);
+	void settle(MemoryPacket *& slot);
+	void enter(bool& buffer, uint64_t& issued,
+		std::vector<MemoryPacket *>& queue, MemoryPacket *& request,
+		const uint64_t& tick);
+	void blockedOn(const bool& left, const MemoryPacket *packet);
+	void respond(MemoryPacket *& response, const uint64_t& tick);
+	bool leftOf(const MemoryPacket& packet) const;
+	void answer(MemoryPacket *packet, const uint64_t& tick);
 
 public:
 	Mux* upstreamMux;
 	Mux* downstreamMuxLow;
 	Mux* downstreamMuxHigh;
 	Mux():  leftBuffer(false), rightBuffer(false), 
-	        bottomLeftMutex(nullptr), bottomRightMutex(nullptr),
+		leftFreed(0), rightFreed(0), leftIssued(0), rightIssued(0),
+		arbiter(nullptr), bottomLeftMutex(nullptr), bottomRightMutex(nullptr),
+		leftRequest(nullptr), rightRequest(nullptr),
+		leftFill(nullptr), rightFill(nullptr),
+		leftResponse(nullptr), rightResponse(nullptr), ddr(nullptr),
+		coalescer(nullptr), stats(nullptr), wormhole(nullptr),
 	        upstreamMux(nullptr), downstreamMuxLow(nullptr),
 		downstreamMuxHigh(nullptr) {};
-	Mux(Memory *gMem): globalMemory(gMem) {};
+	Mux(GlobalMemory *gMem, const unsigned long c):
+		globalMemory(gMem), channel(c), arbiter(nullptr),
+		ddr(nullptr), coalescer(nullptr), stats(nullptr),
+		wormhole(nullptr) {};
 	~Mux();
 	void initialiseMutex();
-	void fillBottomBuffer(bool& buffer,
+	void setArbiter(Arbiter *a) { arbiter = a; }
+	void setDDR(DDRController *controller) { ddr = controller; }
+	void setCoalescer(Coalescer *stage) { coalescer = stage; }
+	void setStats(SideStats *sides) { stats = sides; }
+	void setWormhole(Wormhole *network) { wormhole = network; }
+	void fillBottomBuffer(bool& buffer, uint64_t& freed,
 		std::mutex *botMutex, MemoryPacket& packet);
-	void routeDown(MemoryPacket& packet);
-	void assignGlobalMemory(Memory *gMem){ globalMemory = gMem; }
+	void routeDown(MemoryPacket& packet, const bool& packetOnLeft);
+	void assignGlobalMemory(GlobalMemory *gMem, const unsigned long c)
+		{ globalMemory = gMem; channel = c; }
 	void joinUpMux(const Mux& left, const Mux& right);
 	void assignNumbers(const uint64_t& ll, const uint64_t& ul,
 		const uint64_t& lr, const uint64_t& ur);
 	const std::tuple<const uint64_t, const uint64_t,
 		const uint64_t, const uint64_t> fetchNumbers() const;
-	void routePacket(MemoryPacket& pack);
+	void enterLeaf(MemoryPacket& packet, const bool& left);
     	bool acceptPacketUp(const MemoryPacket& mPack) const;
-	void postPacketUp(MemoryPacket& packet);
-	void keepRoutingPacket(MemoryPacket& packet);
+	void postPacketUp(MemoryPacket& packet, const bool& left,
+		Mux& upstream, const bool& upstreamLeft);
+	void injectPacket(MemoryPacket& packet, const bool& left);
+	void sendFlits(MemoryPacket& packet);
+	void offToDDR(MemoryPacket *request, const uint64_t& tick);
+	void commit(const uint64_t& tick);
+	void commitDown(const uint64_t& tick);
 
 };	
 #endif
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <vector>
+#include "muxstats.hpp"
+
+using namespace std;
+
+void SideStats::clear()
+{
+	full = 0;
+	grants = 0;
+	blocked = 0;
+	latency = 0;
+	for (uint64_t i = 0; i < LATENCY_BUCKETS; i++) {
+		buckets[i] = 0;
+	}
+}
+
+void SideStats::passed(const uint64_t& ticks)
+{
+	uint64_t bucket = 0;
+	while (bucket < LATENCY_BUCKETS - 1 && (1UL << bucket) <= ticks) {
+		bucket++;
+	}
+	grants++;
+	latency += ticks;
+	buckets[bucket]++;
+}
+
+MuxStats::MuxStats(const uint64_t& ticks, const unsigned long c,
+	const uint64_t& nodeCount, const long l):
+	window(ticks > 0 ? ticks : 1), channel(c), levels(l),
+	current(nodeCount * 2), windowStart(0), lastTick(0)
+{
+}
+
+//a tick past the window closes it - when the barrier skips ahead the
+//next window starts on the boundary the tick is in
+void MuxStats::tick(const uint64_t& tick)
+{
+	lastTick = tick;
+	if (tick < windowStart + window) {
+		return;
+	}
+	series.push_back(current);
+	starts.push_back(windowStart);
+	for (auto& side: current) {
+		side.clear();
+	}
+	windowStart = tick - tick % window;
+}
+
+void MuxStats::writeHeader(ostream& out)
+{
+	out << "start,ticks,channel,level,node,side,occupancy,grants,";
+	out << "blocked,mean_latency,lat_0";
+	for (uint64_t i = 1; i < LATENCY_BUCKETS; i++) {
+		out << ",lat_" << (1UL << (i - 1));
+	}
+	out << endl;
+}
+
+//levels count up from the leaves - heap order counts down from the root
+void MuxStats::writeWindow(ostream& out, const uint64_t& start,
+	const uint64_t& ticks, const vector<SideStats>& sides) const
+{
+	long depth = 0;
+	for (uint64_t node = 0; node < sides.size() / 2; node++) {
+		if (node + 2 > (2UL << depth)) {
+			depth++;
+		}
+		for (uint64_t side = 0; side < 2; side++) {
+			const SideStats& stats = sides[node * 2 + side];
+			if (stats.idle()) {
+				continue;
+			}
+			out << start << "," << ticks << "," << channel << ",";
+			out << levels - depth << "," << node << ",";
+			out << (side == 0 ? "left" : "right") << ",";
+			out << (double)stats.full / ticks << ",";
+			out << stats.grants << "," << stats.blocked << ",";
+			out << (stats.grants > 0 ?
+				(double)stats.latency / stats.grants : 0.0);
+			for (uint64_t i = 0; i < LATENCY_BUCKETS; i++) {
+				out << "," << stats.buckets[i];
+			}
+			out << "\n";
+		}
+	}
+}
+
+//the window still open at the end of the run is written as far as
+//it got
+void MuxStats::write(ostream& out) const
+{
+	for (uint64_t i = 0; i < series.size(); i++) {
+		writeWindow(out, starts[i], window, series[i]);
+	}
+	if (lastTick >= windowStart) {
+		writeWindow(out, windowStart, lastTick + 1 - windowStart,
+			current);
+	}
+}
@@ -0,0 +1,57 @@
+//congestion in the Mux trees, side by side and window by window
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#ifndef _MUXSTATS_CLASS_
+#define _MUXSTATS_CLASS_
+
+//ticks a packet spent in a buffer - 0, 1, 2-3, 4-7 ... 1024 and over
+static const uint64_t LATENCY_BUCKETS = 12;
+
+//one buffer of a Mux over a window
+class SideStats {
+public:
+	//ticks it held a packet
+	uint32_t full;
+	//packets it passed on
+	uint32_t grants;
+	//ticks packets spent waiting to get into it or out of it
+	uint32_t blocked;
+	//ticks the packets it passed on spent in it
+	uint32_t latency;
+	uint32_t buckets[LATENCY_BUCKETS];
+	SideStats() { clear(); }
+	void clear();
+	void passed(const uint64_t& ticks);
+	bool idle() const { return full == 0 && grants == 0 && blocked == 0; }
+};
+
+//every buffer of a tree - the Muxes fill in the current window in the
+//commits and the tree closes it every window ticks. Kept until the end
+//of the run, then written as CSV, a line per busy buffer per window
+class MuxStats {
+private:
+	const uint64_t window;
+	const unsigned long channel;
+	const long levels;
+	//two a node, in the tree's heap order
+	std::vector<SideStats> current;
+	//closed windows and the ticks they started on
+	std::vector<std::vector<SideStats>> series;
+	std::vector<uint64_t> starts;
+	uint64_t windowStart;
+	uint64_t lastTick;
+	void writeWindow(std::ostream& out, const uint64_t& start,
+		const uint64_t& ticks, const std::vector<SideStats>& sides) const;
+
+public:
+	MuxStats(const uint64_t& ticks, const unsigned long c,
+		const uint64_t& nodeCount, const long l);
+	SideStats* sidesOf(const uint64_t& node) { return &current[node * 2]; }
+	//before the Muxes commit a tick
+	void tick(const uint64_t& tick);
+	static void writeHeader(std::ostream& out);
+	void write(std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "mainwindow.h"
+#include "ControlThread.hpp"
+#include "memorypacket.hpp"
+#include "mux.hpp"
+#include "memory.hpp"
+#include "tile.hpp"
+#include "processor.hpp"
+#include "netmodel.hpp"
+
+using namespace std;
+
+//level l has a buffer for every 2^l tiles
+NetworkModel::NetworkModel(const long treeLevels, const long tiles,
+	const bool alone):
+	levels(treeLevels), standIn(alone), packets(0), modelTicks(0),
+	checked(0), muxTicks(0), errorSum(0), errorSquares(0), worstError(0)
+{
+	for (long i = 0; i <= levels; i++) {
+		freeAt.push_back(vector<uint64_t>(max(tiles >> i, 1L), 0));
+	}
+}
+
+//the tick the data reaches tile order asking on tick - a packet holds
+//each buffer until it gets into the next one, and the root's until it
+//goes off to DDR
+uint64_t NetworkModel::reserve(const uint64_t& order, const uint64_t& tick)
+{
+	unique_lock<mutex> lck(reserveLock);
+	uint64_t at = tick;
+	uint64_t *held = nullptr;
+	for (long i = 0; i <= levels; i++) {
+		uint64_t& buffer = freeAt[i][order >> i];
+		at = max(at + GLOBALCLOCKSLOW, buffer);
+		if (held) {
+			*held = at;
+		}
+		held = &buffer;
+	}
+	at += GLOBALCLOCKSLOW;
+	*held = at;
+	at += DDR_DELAY * GLOBALCLOCKSLOW;
+	packets++;
+	modelTicks += at - tick;
+	return at;
+}
+
+void NetworkModel::check(const uint64_t& start, const uint64_t& predicted,
+	const uint64_t& finished)
+{
+	const int64_t error = (int64_t)predicted - (int64_t)finished;
+	unique_lock<mutex> lck(reserveLock);
+	checked++;
+	muxTicks += finished - start;
+	errorSum += error;
+	errorSquares += error * error;
+	worstError = max(worstError, (uint64_t)llabs(error));
+}
+
+void NetworkModel::report(const unsigned long channel) const
+{
+	if (packets == 0) {
+		return;
+	}
+	cout << "Network model, block " << channel << ": " << packets;
+	cout << " packets, mean " << (double)modelTicks / packets;
+	cout << " ticks to DDR and back" << endl;
+	if (checked == 0) {
+		return;
+	}
+	const double mean = (double)errorSum / checked;
+	const double spread = sqrt(max(0.0,
+		(double)errorSquares / checked - mean * mean));
+	cout << "Network model, block " << channel << ": Mux trees mean ";
+	cout << (double)muxTicks / checked << " ticks - model error ";
+	cout << mean << " +/- " << spread << " ticks, worst ";
+	cout << worstError << endl;
+}
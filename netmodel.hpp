@@ -0,0 +1,44 @@
+//Transaction level stand-in for a Mux tree
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#ifndef _NETMODEL_CLASS_
+#define _NETMODEL_CLASS_
+
+//how memory packets cross the network
+enum NetworkMode { MUX_NETWORK, MODEL_NETWORK, CHECKED_NETWORK };
+
+//A packet's completion tick comes straight from the tree depth, the
+//ticks each buffer on its path is already promised for and DDR_DELAY.
+//Buffers are handed out first come first served, in the order tiles
+//ask - no left priority - so a checked run reports how far that is
+//from the Mux trees.
+class NetworkModel {
+
+private:
+	const long levels;
+	const bool standIn;
+	//tick each buffer is next free, by level and then by the tiles
+	//that share it
+	std::vector<std::vector<uint64_t>> freeAt;
+	std::mutex reserveLock;
+	uint64_t packets;
+	uint64_t modelTicks;
+	//checked runs - model less Mux, per packet
+	uint64_t checked;
+	uint64_t muxTicks;
+	int64_t errorSum;
+	uint64_t errorSquares;
+	uint64_t worstError;
+
+public:
+	NetworkModel(const long treeLevels, const long tiles,
+		const bool alone);
+	bool isStandIn() const { return standIn; }
+	uint64_t reserve(const uint64_t& order, const uint64_t& tick);
+	void check(const uint64_t& start, const uint64_t& predicted,
+		const uint64_t& finished);
+	void report(const unsigned long channel) const;
+};
+
+#endif
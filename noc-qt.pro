@@ -18,7 +18,19 @@ CONFIG += c++11
 SOURCES += main.cpp\
         mainwindow.cpp \
     ControlThread.cpp \
+    barrier.cpp \
+    scheduler.cpp \
+    warp.cpp \
+    snapshot.cpp \
+    netmodel.cpp \
+    mesh.cpp \
+    arbiter.cpp \
+    ddr.cpp \
+    coalesce.cpp \
+    muxstats.cpp \
+    wormhole.cpp \
     memory.cpp \
+    coldstore.cpp \
     memorypacket.cpp \
     mux.cpp \
     noc.cpp \
@@ -30,8 +42,21 @@ SOURCES += main.cpp\
     tree.cpp
 
 HEADERS  += mainwindow.h \
+    nocconfig.hpp \
     ControlThread.hpp \
+    barrier.hpp \
+    scheduler.hpp \
+    warp.hpp \
+    snapshot.hpp \
+    netmodel.hpp \
+    mesh.hpp \
+    arbiter.hpp \
+    ddr.hpp \
+    coalesce.hpp \
+    muxstats.hpp \
+    wormhole.hpp \
     memory.hpp \
+    coldstore.hpp \
     memorypacket.hpp \
     mux.hpp \
     noc.hpp \
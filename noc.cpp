@@ -25,52 +25,100 @@
 #include "paging.hpp"
 #include "processorFunc.hpp"
 #include "ControlThread.hpp"
+#include "scheduler.hpp"
+#include "warp.hpp"
+#include "snapshot.hpp"
+#include "netmodel.hpp"
+#include "mesh.hpp"
+#include "arbiter.hpp"
+#include "ddr.hpp"
+#include "muxstats.hpp"
 
 #define PAGE_TABLE_COUNT 256
 
 using namespace std;
 
-Noc::Noc(const long columns, const long rows, const long pageShift,
-    const long bSize, MainWindow* pWind, const long blocks):
-    columnCount(columns), rowCount(rows),
-    blockSize(bSize), mainWindow(pWind), memoryBlocks(blocks)
+Noc::Noc(const NocConfig& config, MainWindow* pWind):
+    columnCount(config.columns), rowCount(config.rows),
+    blockSize(config.blockSize), workerThreads(config.workerThreads),
+    quantum(config.quantum), warpWindow(config.warpWindow),
+    arbitration(config.arbitration), outstanding(config.outstanding),
+    ddrScheduling(config.ddrScheduling),
+    coalesceWindow(config.coalesceWindow), statsFile(config.statsFile),
+    statsWindow(config.statsWindow),
+    virtualChannels(config.virtualChannels),
+    channelDepth(config.channelDepth), strictFile(config.strictFile),
+    globalMemory(config.memoryBlocks, config.blockSize,
+	config.interleaveShift > 0 ? config.interleaveShift : config.pageShift,
+	MemoryTiers(config.hotLimit, config.coldLimit, config.spillFile)),
+    snapshot(nullptr), mainWindow(pWind),
+    memoryBlocks(config.memoryBlocks), mesh(nullptr)
 {
+	if (!config.snapshotFile.empty()) {
+		SnapshotKey key;
+		key.columns = config.columns;
+		key.rows = config.rows;
+		key.pageShift = config.pageShift;
+		key.blocks = config.memoryBlocks;
+		key.blockSize = config.blockSize;
+		key.interleaveShift = config.interleaveShift > 0 ?
+			config.interleaveShift : config.pageShift;
+		key.tileMemory = TILE_MEM_SIZE;
+		key.variables = Snapshot::hashFile("./variables.csv");
+		snapshot = new Snapshot(config.snapshotFile, key);
+	}
+	//a matching snapshot already holds the tiles' page tables
+	const bool buildTables = !snapshot || !snapshot->matches();
     uint64_t number = 0;
-    for (int i = 0; i < columns; i++) {
-		tiles.push_back(vector<Tile *>(rows));
-		for (int j = 0; j < rows; j++) {
-    		        tiles[i][j] = new Tile(
-				this, i, j, pageShift, mainWindow, number++);
+    for (int i = 0; i < config.columns; i++) {
+		tiles.push_back(vector<Tile *>(config.rows));
+		for (int j = 0; j < config.rows; j++) {
+    		        tiles[i][j] = new Tile(this, i, j, config.pageShift,
+				mainWindow, number++, buildTables);
+		}
+	}
+	if (!buildTables) {
+		for (int i = 0; i < config.columns * config.rows; i++) {
+			snapshot->restoreLocal(i, *(tileAt(i)->getLocal()));
 		}
 	}
 	//construct non-memory network
-	//NB currently not used
-	for (int i = 0; i < columns; i++) {
-		for (int j = 0; j < (rows - 1); j++) {
+	for (int i = 0; i < config.columns; i++) {
+		for (int j = 0; j < (config.rows - 1); j++) {
 			tiles[i][j]->addConnection(i, j + 1);
 			tiles[i][j + 1]->addConnection(i, j);
 		}
 	}
-	for (int i = 0; i < (columns - 1); i++) {
-		for (int j = 0; j < rows; j++) {
+	for (int i = 0; i < (config.columns - 1); i++) {
+		for (int j = 0; j < config.rows; j++) {
 			tiles[i][j]->addConnection(i + 1, j);
 			tiles[i + 1][j]->addConnection(i, j);
 		}
 	}
+	if (config.meshLatency > 0) {
+		mesh = new Mesh(*this, config.meshLatency, config.meshWidth);
+	}
+	for (int i = 0; i < config.columns * config.rows; i++) {
+		waits.push_back(new WaitHistogram());
+	}
 
-	for (int i = 0; i < memoryBlocks; i++) {
-		globalMemory.push_back(Memory(i * blockSize, blockSize));
+	for (int i = 0; i < config.columns; i++) {
+		for (int j = 0; j < config.rows; j++) {
+			tiles[i][j]->mapGlobal(&globalMemory);
+		}
 	}
 
-	//in reality we are only using one tree and one memory block
-	trees.push_back(new Tree(globalMemory[0], *this, columns, rows));
-/*
+	//one tree per channel
 	for (int i = 0; i < memoryBlocks; i++)
 	{
-		trees.push_back(new Tree(globalMemory[i], *this, columns,
-			rows));
+		trees.push_back(new Tree(globalMemory, i, *this, config.columns,
+			config.rows, arbitration));
+		if (config.network != MUX_NETWORK) {
+			models.push_back(new NetworkModel(
+				trees[i]->getLevels(), config.columns * config.rows,
+				config.network == MODEL_NETWORK));
+		}
 	}
-*/
 	pBarrier = nullptr;
 }
 
@@ -86,6 +134,14 @@ Noc::~Noc()
 	for (int i = 0; i < memoryBlocks; i++) {
 		delete trees[i];
 	}
+	for (auto model: models) {
+		delete model;
+	}
+	delete mesh;
+	for (auto wait: waits) {
+		delete wait;
+	}
+	delete snapshot;
 }
 
 Tile* Noc::tileAt(long i)
@@ -128,7 +184,7 @@ unsigned long Noc::scanLevelFourTable(unsigned long offsetAddr)
 {
 	//scan through pages looking for first available, non-fixed
 	for (int i = 0; i < (1 << 18); i++) {
-		uint8_t pageStatus = globalMemory[0].
+		uint8_t pageStatus = globalMemory.
 			readByte(offsetAddr + sizeof(long));
 		if (pageStatus == 0) {
 			goto fail;
@@ -147,40 +203,38 @@ void Noc::writeSystemToMemory()
 	//write variables out to memory as AP integers
 	//begin by looking through pages for first non-fixed pages
 	unsigned long levelTwoTableAddr =
-		globalMemory[0].readLong(ptrBasePageTables);
+		globalMemory.readLong(ptrBasePageTables);
 	unsigned long levelThreeTableAddr =
-		globalMemory[0].readLong(levelTwoTableAddr);
-	unsigned long levelFourTableAddr = globalMemory[0].
+		globalMemory.readLong(levelTwoTableAddr);
+	unsigned long levelFourTableAddr = globalMemory.
 		readLong(levelThreeTableAddr);
 	unsigned long firstFreePageAddr =
 		scanLevelFourTable(levelFourTableAddr);
-	unsigned long address = globalMemory[0].readLong(firstFreePageAddr);
-	globalMemory[0].writeLong(sizeof(long) * 2, address);
+	unsigned long address = globalMemory.readLong(firstFreePageAddr);
+	globalMemory.writeLong(sizeof(long) * 2, address);
 	for (uint32_t i = 0; i < lines.size(); i++) {
 		for (uint32_t j = 0; j <= lines.size(); j++) {
 			//nominator
 			long sign = sgn(lines[i][j]);
 			if (sign < 1) {
-				globalMemory[0].writeByte(address, 0x01);
+				globalMemory.writeByte(address, 0x01);
 			} else {
-				globalMemory[0].writeByte(address, 0);
+				globalMemory.writeByte(address, 0);
 			}
 			address++;
-			globalMemory[0].writeByte(address, APNUMBERSIZE);
+			globalMemory.writeByte(address, APNUMBERSIZE);
 			address+= (sizeof(uint64_t) - 1);
-			globalMemory[0].writeLong(address,abs(lines[i][j]));
+			globalMemory.writeLong(address,abs(lines[i][j]));
 			address += sizeof(uint64_t);
-			for (int k = 0; k < APNUMBERSIZE - 1; k++) {
-				globalMemory[0].writeLong(address, 0);
-                		address += sizeof(uint64_t);
-			}
+			globalMemory.fill(address, 0,
+				(APNUMBERSIZE - 1) * sizeof(uint64_t));
+			address += (APNUMBERSIZE - 1) * sizeof(uint64_t);
 			//denominator
-            		globalMemory[0].writeLong(address , 1);
+            		globalMemory.writeLong(address , 1);
             		address+= sizeof(uint64_t);
-            		for (int k = 0; k < APNUMBERSIZE - 1; k++) {
-				globalMemory[0].writeLong(address, 0);
-                		address += sizeof(uint64_t);
-			}	
+			globalMemory.fill(address, 0,
+				(APNUMBERSIZE - 1) * sizeof(uint64_t));
+			address += (APNUMBERSIZE - 1) * sizeof(uint64_t);
 		}
 	}
 }	
@@ -196,32 +250,32 @@ unsigned long Noc::createBasicPageTables()
     PageTable superDirectory(12);
     uint64_t runLength = 0;
     uint64_t superDirectoryLength =
-		superDirectory.streamToMemory(globalMemory[0],
+		superDirectory.streamToMemory(globalMemory,
 		startOfPageTables);
-    globalMemory[0].writeLong(startOfPageTables + runLength,
+    globalMemory.writeLong(startOfPageTables + runLength,
         startOfPageTables + runLength + superDirectoryLength);
 	//mark address as valid
-    globalMemory[0].writeByte(startOfPageTables + sizeof(uint64_t),
+    globalMemory.writeByte(startOfPageTables + sizeof(uint64_t),
 		1);
     runLength += superDirectoryLength;
 
     PageTable directory(12);
     uint64_t directoryLength =
-		directory.streamToMemory(globalMemory[0],
+		directory.streamToMemory(globalMemory,
 		startOfPageTables + runLength);
-	globalMemory[0].writeLong(startOfPageTables + runLength,
+	globalMemory.writeLong(startOfPageTables + runLength,
 		startOfPageTables + runLength + directoryLength);
-	globalMemory[0].writeByte(
+	globalMemory.writeByte(
         startOfPageTables + runLength + sizeof(uint64_t), 1);
 	runLength += directoryLength;
 
     PageTable superTable(12);
     uint64_t superTableLength =
-		superTable.streamToMemory(globalMemory[0],
+		superTable.streamToMemory(globalMemory,
 		startOfPageTables + runLength);
-	globalMemory[0].writeLong(startOfPageTables + runLength,
+	globalMemory.writeLong(startOfPageTables + runLength,
         startOfPageTables + runLength + superTableLength);
-	globalMemory[0].writeByte(
+	globalMemory.writeByte(
         startOfPageTables + runLength + sizeof(uint64_t), 1);
     runLength += superTableLength;
 
@@ -231,30 +285,30 @@ unsigned long Noc::createBasicPageTables()
         tables.push_back(pageTable);
     }
     uint64_t tableLength =
-        tables[0].streamToMemory(globalMemory[0],
+        tables[0].streamToMemory(globalMemory,
 		startOfPageTables + runLength);
     for (int i = 1; i < PAGE_TABLE_COUNT; i++) {
-        tables[i].streamToMemory(globalMemory[0],
+        tables[i].streamToMemory(globalMemory,
                 startOfPageTables + runLength + i * tableLength);
     }
     for (int i = 0; i < PAGE_TABLE_COUNT; i++) {
         uint64_t offsetA = startOfPageTables + runLength - superTableLength +
                 i * (sizeof(uint64_t) + sizeof(uint8_t));
-        globalMemory[0].writeLong(offsetA,
+        globalMemory.writeLong(offsetA,
             startOfPageTables + runLength + tableLength * i);
-        globalMemory[0].writeByte(offsetA + sizeof(uint64_t), 0x01);
+        globalMemory.writeByte(offsetA + sizeof(uint64_t), 0x01);
     }
     uint64_t bottomOfPageTable = runLength + tableLength * PAGE_TABLE_COUNT;
     for (unsigned int i = 0; i < (1 << 8) * PAGE_TABLE_COUNT; i++) {
         uint64_t offsetB = startOfPageTables + runLength
                 + i * (sizeof(uint64_t) + sizeof(uint8_t));
-        globalMemory[0].writeLong(offsetB, i * (1 << PAGE_SHIFT));
+        globalMemory.writeLong(offsetB, i * (1 << PAGE_SHIFT));
         uint8_t flagOut = 0x03;
         if (i > (2 + ((bottomOfPageTable + startOfPageTables) >> PAGE_SHIFT)))
         {
             	flagOut = 0x01;
         }
-        globalMemory[0].writeByte(offsetB + sizeof(uint64_t), flagOut);
+        globalMemory.writeByte(offsetB + sizeof(uint64_t), flagOut);
     	}
 
     	runLength += tableLength * PAGE_TABLE_COUNT;
@@ -275,11 +329,146 @@ long Noc::executeInstructions()
 	startRegions.addRegion(0);
 	startRegions.addRegion(4096);
 
-	ptrBasePageTables = createBasicPageTables();
-
-    	readInVariables();
-	writeSystemToMemory();
-    	pBarrier = new ControlThread(0, mainWindow);
+	if (snapshot && snapshot->matches()) {
+		snapshot->restoreGlobal(globalMemory);
+		ptrBasePageTables = snapshot->getBasePageTables();
+	} else {
+		ptrBasePageTables = createBasicPageTables();
+		readInVariables();
+		writeSystemToMemory();
+		if (snapshot) {
+			vector<Memory *> locals;
+			for (int i = 0; i < columnCount * rowCount; i++) {
+				locals.push_back(tileAt(i)->getLocal());
+			}
+			snapshot->save(globalMemory, locals, ptrBasePageTables);
+		}
+	}
+	delete snapshot;
+	snapshot = nullptr;
+	//a quantum no longer than the quickest trip through the tree
+	//to DDR means no tile can see another's request early
+	const long maxQuantum = (trees[0]->getLevels() + 1 + DDR_DELAY) *
+		GLOBALCLOCKSLOW;
+	if (quantum < 1 || quantum > maxQuantum) {
+		cerr << "Quantum must be between 1 and " << maxQuantum;
+		cerr << " ticks - using " << maxQuantum << endl;
+		quantum = quantum < 1 ? 1 : maxQuantum;
+	}
+	//Time Warp needs no quantum, but does need fibers to checkpoint
+	TimeWarp *warp = nullptr;
+	if (warpWindow > 0) {
+		if (quantum != 1) {
+			cerr << "Time Warp ignores the quantum" << endl;
+			quantum = 1;
+		}
+		warp = new TimeWarp(columnCount * rowCount, warpWindow);
+		//a rollback could not give back a model's reservations
+		if (!models.empty()) {
+			cerr << "Time Warp needs the Mux trees - not modelling";
+			cerr << " the network" << endl;
+			for (auto model: models) {
+				delete model;
+			}
+			models.clear();
+		}
+		//nor take back a message once it is routed
+		if (mesh) {
+			cerr << "Time Warp has no mesh - signalling through";
+			cerr << " memory" << endl;
+			delete mesh;
+			mesh = nullptr;
+		}
+	}
+    	pBarrier = new ControlThread(0, mainWindow, quantum);
+	pBarrier->setWarp(warp);
+	pBarrier->setMesh(mesh);
+	//strict mode settles the Mux buffers in the barrier
+	if (quantum == 1 && warp == nullptr) {
+		pBarrier->setTwoPhase(&trees);
+	}
+	//the commits carry split packets - and the model has no response
+	//path to carry them on
+	if (outstanding > 0 && (!pBarrier->isTwoPhase() || !models.empty())) {
+		cerr << "Split transactions need strict mode and the Mux";
+		cerr << " trees - one request at a time" << endl;
+		outstanding = 0;
+	}
+	for (int i = 0; i < columnCount * rowCount; i++) {
+		tileAt(i)->tileProcessor->setOutstanding(outstanding);
+	}
+	//the controllers and coalescers tick in the commits too, and the
+	//model has no banks to keep
+	if (ddrScheduling != FLAT_DDR &&
+		(!pBarrier->isTwoPhase() || !models.empty())) {
+		cerr << "The DDR controller needs strict mode and the Mux";
+		cerr << " trees - every access waits " << DDR_DELAY;
+		cerr << " ticks" << endl;
+		ddrScheduling = FLAT_DDR;
+	}
+	if (coalesceWindow > 0 &&
+		(!pBarrier->isTwoPhase() || !models.empty())) {
+		cerr << "Coalescing needs strict mode and the Mux trees -";
+		cerr << " every request goes to DDR alone" << endl;
+		coalesceWindow = 0;
+	}
+	//and so do the routers
+	if (virtualChannels > 0 &&
+		(!pBarrier->isTwoPhase() || !models.empty())) {
+		cerr << "Virtual channels need strict mode and the Mux trees";
+		cerr << " - whole packets move a Mux at a time" << endl;
+		virtualChannels = 0;
+	}
+	if (virtualChannels > 0 && channelDepth == 0) {
+		cerr << "A virtual channel needs room for a flit - buffering";
+		cerr << " one" << endl;
+		channelDepth = 1;
+	}
+	//the Muxes count in their commits
+	if (!statsFile.empty() && !pBarrier->isTwoPhase()) {
+		cerr << "Mux statistics need strict mode - not kept" << endl;
+		statsFile.clear();
+	}
+	if (!statsFile.empty() && virtualChannels > 0) {
+		cerr << "Mux statistics count the Mux buffers, which flits";
+		cerr << " pass by - not kept" << endl;
+		statsFile.clear();
+	}
+	for (int i = 0; i < memoryBlocks; i++) {
+		if (!statsFile.empty()) {
+			trees[i]->attachStats(statsWindow, i);
+		}
+		if (ddrScheduling != FLAT_DDR) {
+			trees[i]->attachDDR(ddrScheduling, globalMemory);
+		}
+		if (coalesceWindow > 0) {
+			trees[i]->attachCoalescer(coalesceWindow);
+		}
+		if (virtualChannels > 0) {
+			trees[i]->attachWormhole(virtualChannels, channelDepth,
+				arbitration);
+		}
+	}
+	//a packet's round trip through an idle tree - into the leaf, up
+	//a tick a level and out of the root, then DDR. Flits come back down
+	//the same way, and the ticks the rest of a worm takes count as waits
+	const uint64_t emptyTrip = ((virtualChannels > 0 ? 2 : 1) *
+		(trees[0]->getLevels() + 2) +
+		(ddrScheduling != FLAT_DDR ? DDRController::fastest() :
+		DDR_DELAY)) * GLOBALCLOCKSLOW;
+	if (workerThreads > 0 || warp) {
+		//M:N - tiles are fibers shared out over the workers
+		TileScheduler scheduler(pBarrier,
+			workerThreads > 0 ? workerThreads : 1, warp);
+		pBarrier->setScheduler(&scheduler);
+		for (int i = 0; i < columnCount * rowCount; i++) {
+			scheduler.addTile(tileAt(i));
+		}
+		pBarrier->begin();
+		scheduler.execute();
+		report(emptyTrip, warp);
+		return 0;
+	}
 	vector<thread *> threads;
 
 	for (int i = 0; i < columnCount * rowCount; i++) {
@@ -293,9 +482,112 @@ long Noc::executeInstructions()
 	for (int i = 0; i < columnCount * rowCount; i++) {
 		threads[i]->join();
 	}
+	report(emptyTrip, nullptr);
+	return 0;
+}
+
+//end of a run, however the tiles ran - everything we kept count of,
+//then the barrier (and Time Warp) go
+void Noc::report(const uint64_t& emptyTrip, TimeWarp *warp)
+{
+	pBarrier->reportQuantum();
+	globalMemory.reportTiers();
+	for (unsigned long i = 0; i < models.size(); i++) {
+		models[i]->report(i);
+	}
+	if (mesh) {
+		mesh->report();
+	}
+	for (int i = 0; i < memoryBlocks; i++) {
+		trees[i]->reportDDR(i);
+		trees[i]->reportCoalescing(i);
+		trees[i]->reportWormhole(i);
+	}
+	reportWaits(arbitration, emptyTrip, waits);
+	writeMuxStats();
+	compareStrict();
+	if (warp) {
+		warp->report();
+		delete warp;
+	}
 	delete pBarrier;
 	pBarrier = nullptr;
-	return 0;
+}
+
+//a CSV line per busy Mux buffer per window, every tree
+void Noc::writeMuxStats() const
+{
+	if (statsFile.empty()) {
+		return;
+	}
+	ofstream out(statsFile);
+	if (!out) {
+		cerr << "Could not write Mux statistics to " << statsFile;
+		cerr << endl;
+		return;
+	}
+	MuxStats::writeHeader(out);
+	for (int i = 0; i < memoryBlocks; i++) {
+		trees[i]->writeStats(out);
+	}
+}
+
+//late claims are only part of a quantum run's error - how much later,
+//or sooner, it finished than strict mode did on the same workload is
+//the whole of it
+void Noc::compareStrict()
+{
+	if (strictFile.empty()) {
+		return;
+	}
+	const long tileCount = columnCount * rowCount;
+	if (quantum == 1 && pBarrier->getWarp() == nullptr) {
+		ofstream out(strictFile);
+		if (!out) {
+			cerr << "Could not write strict ticks to " << strictFile;
+			cerr << endl;
+			return;
+		}
+		out << pBarrier->getTicks() << endl;
+		for (int i = 0; i < tileCount; i++) {
+			out << tileAt(i)->tileProcessor->getTicks() << endl;
+		}
+		return;
+	}
+	ifstream in(strictFile);
+	uint64_t strictTicks = 0;
+	vector<uint64_t> strictTiles;
+	uint64_t ticks;
+	if (in >> strictTicks) {
+		while (in >> ticks) {
+			strictTiles.push_back(ticks);
+		}
+	}
+	if (strictTiles.size() != (unsigned long)tileCount) {
+		cerr << "No strict run of " << tileCount << " tiles in ";
+		cerr << strictFile << " - not compared" << endl;
+		return;
+	}
+	const int64_t ended = pBarrier->getTicks() - strictTicks;
+	cout << "End of run against strict mode: " << pBarrier->getTicks();
+	cout << " ticks, strict " << strictTicks << " (" << showpos << ended;
+	cout << noshowpos << ")" << endl;
+	uint64_t totalOff = 0;
+	uint64_t worstOff = 0;
+	int64_t worst = 0;
+	for (int i = 0; i < tileCount; i++) {
+		const int64_t off = tileAt(i)->tileProcessor->getTicks() -
+			strictTiles[i];
+		const uint64_t distance = off < 0 ? -off : off;
+		totalOff += distance;
+		if (distance > worstOff) {
+			worstOff = distance;
+			worst = off;
+		}
+	}
+	cout << "Tiles finished a mean " << (double)totalOff / tileCount;
+	cout << " ticks from strict mode, worst " << showpos << worst;
+	cout << noshowpos << " ticks" << endl;
 }
 
 ControlThread* Noc::getBarrier()
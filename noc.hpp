@@ -4,6 +4,12 @@
 class Tile;
 class Tree;
 class PageTable;
+class Snapshot;
+class NetworkModel;
+class Mesh;
+class WaitHistogram;
+class TimeWarp;
+#include "nocconfig.hpp"
 #include "mainwindow.h"
 
 class Noc {
@@ -14,6 +20,28 @@ private:
 	const long columnCount;
 	const long rowCount;
 	const long blockSize;
+	const long workerThreads;
+	long quantum;
+	const long warpWindow;
+	const long arbitration;
+	//split transactions a tile can have in the trees at once
+	long outstanding;
+	//FCFS or FR-FCFS at each root, or flat DDR_DELAY
+	long ddrScheduling;
+	//ticks the root holds a request for others to merge with
+	uint64_t coalesceWindow;
+	//per-Mux congestion, written here a window of ticks at a time
+	std::string statsFile;
+	const uint64_t statsWindow;
+	//flit level routers with this many virtual channels a port, each
+	//buffering channelDepth flits - none, and the Muxes move packets
+	long virtualChannels;
+	uint64_t channelDepth;
+	//finishing ticks of a strict run, to write or to compare against
+	const std::string strictFile;
+	void writeMuxStats() const;
+	void compareStrict();
+	void report(const uint64_t& emptyTrip, TimeWarp *warp);
 	unsigned long ptrBasePageTables;
 	std::vector<std::vector<Tile * > > tiles;
 	std::vector<long> answers;
@@ -24,14 +52,21 @@ private:
 	unsigned long createBasicPageTables();
 	unsigned long scanLevelFourTable(unsigned long addr);
 	ControlThread *pBarrier;
-	std::vector<Memory> globalMemory;
+	GlobalMemory globalMemory;
+	//set up image to map, or to save once we have built one
+	Snapshot *snapshot;
     MainWindow *mainWindow;
 public:
-	std::vector<Memory>& getGlobal() { return globalMemory;}
+	GlobalMemory& getGlobal() { return globalMemory;}
 	const long memoryBlocks;
 	std::vector<Tree *> trees;
-	Noc(const long columns, const long rows, const long pageShift,
-        const long bSize, MainWindow *pWind, const long memBlocks);
+	//one per tree, when the network is modelled
+	std::vector<NetworkModel *> models;
+	//tile to tile network - null when there is none
+	Mesh *mesh;
+	//every tile's trips through the trees, by order
+	std::vector<WaitHistogram *> waits;
+	Noc(const NocConfig& config, MainWindow *pWind);
 	~Noc();
 	Tile* tileAt(long i);
 	long executeInstructions();
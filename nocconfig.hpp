@@ -0,0 +1,58 @@
+//everything a run is set up with - filled in from the command line
+#include <cstdint>
+#include <string>
+
+#ifndef _NOCCONFIG_CLASS_
+#define _NOCCONFIG_CLASS_
+
+class NocConfig {
+public:
+	long columns;
+	long rows;
+	long pageShift;
+	long memoryBlocks;
+	long blockSize;
+	//fibers on this many workers - none, a thread per tile
+	long workerThreads;
+	//ticks between barriers - 1 is strict
+	long quantum;
+	//ticks a tile may run ahead under Time Warp - none, no Time Warp
+	long warpWindow;
+	//channels take turns every 2^interleaveShift bytes - none, a page
+	long interleaveShift;
+	std::string snapshotFile;
+	//bytes of global memory kept hot, and compressed, before spilling
+	uint64_t hotLimit;
+	uint64_t coldLimit;
+	std::string spillFile;
+	//Mux trees, the analytic model, or both
+	long network;
+	//tile to tile mesh - no latency, no mesh
+	uint64_t meshLatency;
+	uint64_t meshWidth;
+	long arbitration;
+	//split transactions a tile can have in the trees at once
+	long outstanding;
+	//FCFS or FR-FCFS at each root, or flat DDR_DELAY
+	long ddrScheduling;
+	//ticks the root holds a request for others to merge with
+	uint64_t coalesceWindow;
+	//per-Mux congestion, written here a window of ticks at a time
+	std::string statsFile;
+	uint64_t statsWindow;
+	//flit level routers with this many virtual channels a port, each
+	//buffering channelDepth flits - none, and the Muxes move packets
+	long virtualChannels;
+	uint64_t channelDepth;
+	//a strict run writes when it, and each tile, finished here - any
+	//other run on the same workload compares itself against that
+	std::string strictFile;
+	NocConfig(): columns(16), rows(16), pageShift(10), memoryBlocks(1),
+		blockSize(1024 * 1024 * 1024), workerThreads(0), quantum(1),
+		warpWindow(0), interleaveShift(0), hotLimit(0), coldLimit(0),
+		network(0), meshLatency(0), meshWidth(16), arbitration(0),
+		outstanding(0), ddrScheduling(0), coalesceWindow(0),
+		statsWindow(10000), virtualChannels(0), channelDepth(4) {}
+};
+
+#endif
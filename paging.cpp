@@ -2,6 +2,7 @@
 #include <vector>
 #include <utility>
 #include <map>
+#include <cstring>
 #include "memory.hpp"
 #include "paging.hpp"
 
@@ -70,16 +71,16 @@ void PageTable::setPageFlags(const uint64_t& index, uint8_t flags)
 	entries[index].second = flags;
 }
 
-unsigned long PageTable::streamToMemory(Memory& mem, uint64_t address)
+unsigned long PageTable::streamToMemory(GlobalMemory& mem, uint64_t address)
 {
-    uint64_t tLength = 0;
-	for (auto x: entries) {
-		mem.writeLong(address, x.first);
-        address += sizeof(uint64_t);
-        tLength += sizeof(uint64_t);
-		mem.writeByte(address, x.second);
-		address += sizeof(uint8_t);
-		tLength += sizeof(uint8_t);
+	//entries are packed - 8 byte number then a flag byte
+	const uint64_t entrySize = sizeof(uint64_t) + sizeof(uint8_t);
+	vector<uint8_t> packed(entries.size() * entrySize);
+	for (unsigned int i = 0; i < entries.size(); i++) {
+		memcpy(&packed[i * entrySize], &entries[i].first,
+			sizeof(uint64_t));
+		packed[i * entrySize + sizeof(uint64_t)] = entries[i].second;
 	}
-	return tLength;
+	mem.writeBlock(address, packed.data(), packed.size());
+	return packed.size();
 }
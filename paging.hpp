@@ -28,7 +28,7 @@ class PageTable {
 	PageTable(int bitLength);
     uint8_t getPageFlags(const uint64_t& index) const;
     void setPageFlags(const uint64_t& index, uint8_t flags);
-    unsigned long streamToMemory(Memory& mem, uint64_t start);
+    unsigned long streamToMemory(GlobalMemory& mem, uint64_t start);
 	
 };
 
@@ -12,13 +12,19 @@
 #include <condition_variable>
 #include <climits>
 #include <cstdlib>
+#include <algorithm>
 #include "mainwindow.h"
 #include "ControlThread.hpp"
 #include "memorypacket.hpp"
 #include "mux.hpp"
-#include "tile.hpp"
 #include "memory.hpp"
+#include "tile.hpp"
 #include "processor.hpp"
+#include "tree.hpp"
+#include "scheduler.hpp"
+#include "warp.hpp"
+#include "netmodel.hpp"
+#include "mesh.hpp"
 
 //page table flags
 //bit 0 - 0 for invalid entry, 1 for valid
@@ -46,7 +52,10 @@ Processor::Processor(Tile *parent, MainWindow *mW, uint64_t numb):
 	statusWord[0] = true;
 	totalTicks = 1;
 	currentTLB = 0;
+	outstandingDepth = 0;
 	inInterrupt = false;
+	interruptLock = false;
+	cheatHeld = false;
     	processorNumber = numb;
     	clockDue = false;
     	QObject::connect(this, SIGNAL(hardFault()),
@@ -112,10 +121,8 @@ void Processor::writeOutBasicPageEntries(const uint64_t& pagesAvailable)
                     i * (1 << pageShift) + PAGETABLESLOCAL);
 		masterTile->writeLong(
             PAGETABLESLOCAL + memoryLocalOffset + FRAMEOFFSET, i);
-		for (int j = FLAGOFFSET; j < ENDOFFSET; j++) {
-			masterTile->writeByte(
-				PAGETABLESLOCAL + memoryLocalOffset + j, 0);
-		}
+		masterTile->fill(PAGETABLESLOCAL + memoryLocalOffset + FLAGOFFSET,
+			0, ENDOFFSET - FLAGOFFSET);
 	}
 }
 
@@ -155,7 +162,10 @@ void Processor::flushPagesEnd()
     interruptEnd();
 }
 
-void Processor::createMemoryMap(Memory *local, long pShift)
+//writeTables false - the scratchpad comes from a snapshot, so only
+//set up our own state
+void Processor::createMemoryMap(Memory *local, long pShift,
+	const bool writeTables)
 {
 	localMemory = local;
 	pageShift = pShift;
@@ -180,9 +190,12 @@ void Processor::createMemoryMap(Memory *local, long pShift)
 	if ((requiredBitmapPages << pageShift) != totalBitmapSpace) {
 		requiredBitmapPages++;
 	}
-	writeOutPageAndBitmapLengths(requiredPTEPages, requiredBitmapPages);
-	writeOutBasicPageEntries(pagesAvailable);
-	markUpBasicPageEntries(requiredPTEPages, requiredBitmapPages);
+	if (writeTables) {
+		writeOutPageAndBitmapLengths(requiredPTEPages,
+			requiredBitmapPages);
+		writeOutBasicPageEntries(pagesAvailable);
+		markUpBasicPageEntries(requiredPTEPages, requiredBitmapPages);
+	}
 	pageMask = 0xFFFFFFFFFFFFFFFF;
 	pageMask = pageMask >> pageShift;
 	pageMask = pageMask << pageShift;
@@ -192,6 +205,9 @@ void Processor::createMemoryMap(Memory *local, long pShift)
 		const uint64_t pageStart =
 			PAGETABLESLOCAL + i * (1 << pageShift);
 		fixTLB(i, pageStart);
+		if (!writeTables) {
+			continue;
+		}
         for (unsigned int j = 0; j < bitmapSize * BITS_PER_BYTE; j++) {
             markBitmapInit(i, pageStart + j * BITMAP_BYTES);
 		}
@@ -201,6 +217,9 @@ void Processor::createMemoryMap(Memory *local, long pShift)
             (1 << pageShift);
     const uint64_t stackPageNumber = pagesAvailable - 1;
     fixTLB(stackPageNumber, stackPage);
+    if (!writeTables) {
+        return;
+    }
     for (unsigned int i = 0; i < bitmapSize * BITS_PER_BYTE; i++) {
         markBitmapInit(stackPageNumber, stackPage + i * BITMAP_BYTES);
     }
@@ -230,30 +249,50 @@ uint64_t Processor::generateAddress(const uint64_t& frame,
     return (frame << pageShift) + offset + PAGETABLESLOCAL;
 }
 
+//spin on the flag - a fiber hands its tick back between tries
+void Processor::lockInterrupt()
+{
+	bool held = false;
+	while (!interruptLock.compare_exchange_weak(held, true,
+		memory_order_acquire)) {
+		held = false;
+		if (TileScheduler::inFiber()) {
+			TileScheduler::yieldTick();
+		} else {
+			this_thread::yield();
+		}
+	}
+}
+
+void Processor::unlockInterrupt()
+{
+	interruptLock.store(false, memory_order_release);
+}
+
 void Processor::interruptBegin()
 {
-	interruptLock.lock();
+	lockInterrupt();
 	inInterrupt = true;
 	switchModeReal();
+	//two ticks per register - the stack is local so nobody else
+	//can see the order
 	for (auto i: registerFile) {
-		waitATick();
 		pushStackPointer();	
-		waitATick();
 		masterTile->writeLong(stackPointer, i);
 	}
+	sleepFor(registerFile.size() * 2);
 }
 
 void Processor::interruptEnd()
 {
+	sleepFor(registerFile.size() * 2);
 	for (int i = registerFile.size() - 1; i >= 0; i--) {
-		waitATick();
 		registerFile[i] = masterTile->readLong(stackPointer);
-		waitATick();
 		popStackPointer();
 	}
 	switchModeVirtual();
 	inInterrupt = false;
-	interruptLock.unlock();
+	unlockInterrupt();
 }
 
 // Maximum flit size 128 bits
@@ -261,21 +300,177 @@ void Processor::interruptEnd()
 
 //tuple - vector of bytes, size of vector, success
 
-const vector<uint8_t> Processor::requestRemoteMemory(
+//the answer lands in into, a packet's share at a time - or nowhere,
+//for a write back
+void Processor::requestRemoteMemory(
 	const uint64_t& size, const uint64_t& remoteAddress,
-	const uint64_t& localAddress)
-{
-	//assemble request
-	MemoryPacket memoryRequest(this, remoteAddress,
-		localAddress, size);
-	//wait for response
-	if (masterTile->treeLeaf->acceptPacketUp(memoryRequest)) {
-		masterTile->treeLeaf->routePacket(memoryRequest);
-	} else {
-		cerr << "FAILED" << endl;
-		exit(1);
+	const uint64_t& localAddress, uint8_t *into)
+{
+	TimeWarp *warp = masterTile->getBarrier()->getWarp();
+	if (warp) {
+		//a rollback to this transaction resumes here
+		warp->checkpoint(this);
+	}
+	bool rolledBack = false;
+	try {
+		//each channel's share goes up that channel's tree
+		GlobalMemory *global = masterTile->getGlobal();
+		uint64_t sent = 0;
+		while (sent < size) {
+			const uint64_t piece =
+				global->runLength(remoteAddress + sent, size - sent);
+			//assemble request
+			MemoryPacket memoryRequest(this, remoteAddress + sent,
+				localAddress + sent, piece,
+				into ? into + sent : nullptr);
+			Tree *tree = masterTile->treeFor(remoteAddress + sent);
+			NetworkModel *model =
+				masterTile->modelFor(remoteAddress + sent);
+			if (!tree->acceptPacketUp(memoryRequest)) {
+				cerr << "FAILED" << endl;
+				exit(1);
+			}
+			const uint64_t start = totalTicks;
+			if (model && model->isStandIn()) {
+				//no trees - sleep to the tick the model gives
+				sleepUntil(model->reserve(masterTile->getOrder(),
+					start));
+				if (into) {
+					masterTile->readBlock(remoteAddress + sent,
+						into + sent, piece);
+				}
+			} else {
+				//wait for response
+				const uint64_t predicted = model ?
+					model->reserve(masterTile->getOrder(),
+					start) : 0;
+				tree->routePacket(memoryRequest);
+				if (model) {
+					model->check(start, predicted, totalTicks);
+				}
+			}
+			masterTile->recordTrip(totalTicks - start);
+			sent += piece;
+		}
+	} catch (const WarpRollback&) {
+		rolledBack = true;
+	}
+	//packet is gone now - safe to leave this stack behind
+	if (rolledBack) {
+		warp->rollback(this);
+	}
+	if (warp) {
+		warp->endTransaction(this);
+	}
+}
+
+//split transaction - queue a packet a channel at the tile's leaves and
+//carry on, with no more than outstandingDepth in the trees at once.
+//With wait set we are back only when ours are in
+void Processor::issueRemote(const uint64_t& size,
+	const uint64_t& remoteAddress, const uint64_t& localAddress,
+	const function<void(const MemoryPacket&)>& onComplete,
+	const bool& wait)
+{
+	GlobalMemory *global = masterTile->getGlobal();
+	uint64_t sent = 0;
+	while (sent < size) {
+		const uint64_t piece =
+			global->runLength(remoteAddress + sent, size - sent);
+		while (outstanding.size() >= outstandingDepth) {
+			waitGlobalTick();
+			collectRemote();
+		}
+		Transaction transaction;
+		if (onComplete) {
+			transaction.buffer = takeBuffer(piece);
+		}
+		//the buffer's bytes stay put when it is moved
+		MemoryPacket *packet = new MemoryPacket(this,
+			remoteAddress + sent, localAddress + sent, piece,
+			onComplete ? transaction.buffer.data() : nullptr);
+		Tree *tree = masterTile->treeFor(remoteAddress + sent);
+		if (!tree->acceptPacketUp(*packet)) {
+			cerr << "FAILED" << endl;
+			exit(1);
+		}
+		packet->makeSplit(masterTile->getBarrier()->getTicks());
+		tree->injectPacket(*packet);
+		transaction.packet = packet;
+		transaction.onComplete = onComplete;
+		transaction.awaited = wait;
+		outstanding.push_back(move(transaction));
+		sent += piece;
+	}
+	if (!wait) {
+		waitGlobalTick();
+		collectRemote();
+		return;
+	}
+	//a CLOCK in here can collect ours for us
+	while (true) {
+		bool pending = false;
+		for (const auto& transaction: outstanding) {
+			if (transaction.awaited &&
+				!transaction.packet->isDone()) {
+				pending = true;
+				break;
+			}
+		}
+		if (!pending) {
+			break;
+		}
+		waitGlobalTick();
+	}
+	collectRemote();
+}
+
+//run the completions for whatever the trees have brought back
+void Processor::collectRemote()
+{
+	for (auto it = outstanding.begin(); it != outstanding.end();) {
+		if (!it->packet->isDone()) {
+			it++;
+			continue;
+		}
+		MemoryPacket *packet = it->packet;
+		const function<void(const MemoryPacket&)> onComplete =
+			it->onComplete;
+		vector<uint8_t> buffer = move(it->buffer);
+		it = outstanding.erase(it);
+		if (onComplete) {
+			onComplete(*packet);
+		}
+		masterTile->recordTrip(packet->getTrip());
+		delete packet;
+		if (!buffer.empty()) {
+			spareBuffers.push_back(move(buffer));
+		}
+	}
+}
+
+//a spare if there is one - they only grow, so once every size has
+//been seen nothing is allocated
+vector<uint8_t> Processor::takeBuffer(const uint64_t& size)
+{
+	if (spareBuffers.empty()) {
+		return vector<uint8_t>(size);
+	}
+	vector<uint8_t> buffer = move(spareBuffers.back());
+	spareBuffers.pop_back();
+	if (buffer.size() < size) {
+		buffer.resize(size);
+	}
+	return buffer;
+}
+
+//nothing of ours may be left in a tree once the tile is gone
+void Processor::drainRemote()
+{
+	while (!outstanding.empty()) {
+		waitGlobalTick();
+		collectRemote();
 	}
-	return memoryRequest.getMemory();
 }
 
 void Processor::transferGlobalToLocal(const uint64_t& address,
@@ -284,15 +479,24 @@ void Processor::transferGlobalToLocal(const uint64_t& address,
 {
 	//mimic a DMA call - so need to advance PC
 	uint64_t maskedAddress = address & BITMAP_MASK;
-	int offset = 0;
-	vector<uint8_t> answer = requestRemoteMemory(size,
-		maskedAddress, get<1>(tlbEntry) +
-		(maskedAddress & bitMask));
-		for (auto x: answer) {
-			masterTile->writeByte(get<1>(tlbEntry) + offset + 
-				(maskedAddress & bitMask), x);
-			offset++;
-		}
+	if (outstandingDepth > 0) {
+		//write backs ahead of us can still be in the trees
+		issueRemote(size, maskedAddress, get<1>(tlbEntry) +
+			(maskedAddress & bitMask),
+			[this](const MemoryPacket& packet) {
+				masterTile->writeBlock(packet.getLocalAddress(),
+					packet.getMemory(),
+					packet.getRequestSize());
+			}, true);
+		return;
+	}
+	if (staging.size() < size) {
+		staging.resize(size);
+	}
+	requestRemoteMemory(size, maskedAddress, get<1>(tlbEntry) +
+		(maskedAddress & bitMask), staging.data());
+	masterTile->writeBlock(get<1>(tlbEntry) + (maskedAddress & bitMask),
+		staging.data(), size);
 }
 
 void Processor::transferLocalToGlobal(const uint64_t& address,
@@ -302,8 +506,13 @@ void Processor::transferLocalToGlobal(const uint64_t& address,
     //again - this is like a DMA call, there is a delay, but no need
     //to advance the PC
     uint64_t maskedAddress = address & BITMAP_MASK;
+    //split - nobody waits on a write back
+    if (outstandingDepth > 0) {
+        issueRemote(size, get<0>(tlbEntry), maskedAddress, nullptr, false);
+        return;
+    }
     //make the call - ignore the results
-    requestRemoteMemory(size, get<0>(tlbEntry), maskedAddress);
+    requestRemoteMemory(size, get<0>(tlbEntry), maskedAddress, nullptr);
 }
 
 uint64_t Processor::triggerSmallFault(
@@ -403,9 +612,15 @@ void Processor::writeBackMemory(const uint64_t& frameNo)
                     fetchAddressRead(frameNo * (1 << pageShift) +
                     PAGETABLESLOCAL + i * BITMAP_BYTES +
                     j * sizeof(uint64_t)));
-                masterTile->writeLong(fetchAddressWrite(
+                const uint64_t globalAddress = fetchAddressWrite(
                     physicalAddress + i * BITMAP_BYTES
-                    + j * sizeof(uint64_t)), toGo);
+                    + j * sizeof(uint64_t));
+                TimeWarp *warp = masterTile->getBarrier()->getWarp();
+                if (warp) {
+                    warp->writeLong(this, globalAddress, toGo);
+                } else {
+                    masterTile->writeLong(globalAddress, toGo);
+                }
             }
         }
         bitToRead++;
@@ -787,22 +1002,89 @@ void Processor::pcAdvance(const long count)
 	waitATick();
 }
 
-bool Processor::tryCheatLock() const
+bool Processor::tryCheatLock()
 {
 	ControlThread *pBarrier = masterTile->getBarrier();
-	return pBarrier->tryCheatLock();
+	cheatHeld = pBarrier->tryCheatLock();
+	return cheatHeld;
 }
 
-void Processor::cheatUnlock() const
+void Processor::cheatUnlock()
 {
 	ControlThread *pBarrier = masterTile->getBarrier();
+	cheatHeld = false;
 	pBarrier->unlockCheatLock();
 }
 
+void Processor::keepUndoLog()
+{
+	localMemory->keepUndoLog();
+}
+
+void Processor::forgetUndoBefore(const uint64_t& mark)
+{
+	localMemory->forgetBefore(mark);
+}
+
+void Processor::saveState(ProcessorState& state) const
+{
+	state.registerFile = registerFile;
+	state.tlbs = tlbs;
+	state.statusWord = statusWord;
+	state.carryBit = carryBit;
+	state.programCounter = programCounter;
+	state.realMode = (mode == REAL);
+	state.stackPointer = stackPointer;
+	state.inInterrupt = inInterrupt;
+	state.inClock = inClock;
+	state.clockDue = clockDue;
+	state.cheatHeld = cheatHeld;
+	state.totalTicks = totalTicks;
+	state.currentTLB = currentTLB;
+	state.undoMark = localMemory->undoMark();
+}
+
+void Processor::restoreState(const ProcessorState& state)
+{
+	registerFile = state.registerFile;
+	tlbs = state.tlbs;
+	statusWord = state.statusWord;
+	carryBit = state.carryBit;
+	programCounter = state.programCounter;
+	mode = state.realMode ? REAL : VIRTUAL;
+	stackPointer = state.stackPointer;
+	inClock = state.inClock;
+	clockDue = state.clockDue;
+	totalTicks = state.totalTicks;
+	currentTLB = state.currentTLB;
+	localMemory->rewindTo(state.undoMark);
+	//locks are not copied - take or drop them to match
+	if (inInterrupt && !state.inInterrupt) {
+		unlockInterrupt();
+	} else if (!inInterrupt && state.inInterrupt) {
+		lockInterrupt();
+	}
+	inInterrupt = state.inInterrupt;
+	if (cheatHeld && !state.cheatHeld) {
+		cheatUnlock();
+	} else if (!cheatHeld && state.cheatHeld) {
+		while (!tryCheatLock()) {
+			TileScheduler::yieldTick();
+		}
+	}
+}
+
 void Processor::waitATick()
 {
 	ControlThread *pBarrier = masterTile->getBarrier();
-	pBarrier->releaseToRun();
+	TimeWarp *warp = pBarrier->getWarp();
+	//inside a quantum we run on our local clock - tiles only meet
+	//at the quantum boundary - under Time Warp they never meet
+	if (warp) {
+		warp->tick(this);
+	} else if (totalTicks % pBarrier->getQuantum() == 0) {
+		pBarrier->releaseToRun();
+	}
 	totalTicks++;
 	if (totalTicks%clockTicks == 0) {
 		clockDue = true;
@@ -815,9 +1097,88 @@ void Processor::waitATick()
 
 void Processor::waitGlobalTick()
 {
-    for (uint64_t i = 0; i < GLOBALCLOCKSLOW; i++) {
+	sleepFor(GLOBALCLOCKSLOW);
+}
+
+//same as calling waitATick() until totalTicks reaches tick - but
+//the barrier leaves us asleep on the ticks in between
+void Processor::sleepUntil(const uint64_t& tick)
+{
+	sleepThrough(tick, false);
+}
+
+//same as calling waitATick() count times - a CLOCK handler that runs
+//in the middle adds its ticks on top, as it would to the loop
+void Processor::sleepFor(const uint64_t& count)
+{
+	sleepThrough(totalTicks + count, true);
+}
+
+void Processor::sleepThrough(uint64_t tick, const bool stretch)
+{
+	while (totalTicks < tick) {
+		//only the tick that lands on a CLOCK boundary (or one with a
+		//CLOCK pending) can do anything - run that one as normal
+		uint64_t skip = clockTicks - (totalTicks % clockTicks);
+		skip = min(skip, tick - totalTicks) - 1;
+		if (clockDue && inClock == false) {
+			skip = 0;
+		}
+		if (skip > 0) {
+			//sleep through the quantum boundaries those ticks cross
+			ControlThread *pBarrier = masterTile->getBarrier();
+			const uint64_t quantum = pBarrier->getQuantum();
+			if (pBarrier->getWarp() == nullptr) {
+				pBarrier->sleepTicks((totalTicks + skip - 1) /
+					quantum - (totalTicks - 1) / quantum);
+			}
+			totalTicks += skip;
+		}
+		const uint64_t before = totalTicks;
 		waitATick();
+		if (stretch) {
+			tick += totalTicks - before - 1;
+		}
+	}
+}
+
+//over the mesh to another tile - the barrier routes it
+void Processor::sendMessage(const uint64_t& destination,
+	const vector<uint64_t>& words)
+{
+	masterTile->getMesh()->send(masterTile->getOrder(), destination,
+		totalTicks, words);
+	waitATick();
+}
+
+//wait for the next message the mesh delivers to us
+const vector<uint64_t> Processor::receiveMessage()
+{
+	vector<uint64_t> words;
+	Mesh *mesh = masterTile->getMesh();
+	while (!mesh->receive(masterTile->getOrder(), totalTicks, words)) {
+		waitGlobalTick();
+	}
+	return words;
+}
+
+//wait on a Mux buffer off the barrier - the commit that grants the
+//packet wakes us and the ticks spent parked are charged in one go.
+//Not if a CLOCK would fall due in the meantime
+bool Processor::parkForHandoff(MemoryPacket& packet)
+{
+	if (clockDue && inClock == false) {
+		return false;
+	}
+	const uint64_t ticksToClock = clockTicks - 1 - totalTicks % clockTicks;
+	if (ticksToClock == 0) {
+		return false;
 	}
+	ParkedTile parked;
+	packet.park(&parked, ticksToClock);
+	masterTile->getBarrier()->parkTile(parked);
+	totalTicks += packet.getWaited();
+	return true;
 }
 
 void Processor::pushStackPointer()
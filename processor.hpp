@@ -8,16 +8,18 @@
 #include <thread>
 #include <bitset>
 #include <mutex>
+#include <atomic>
 #include <tuple>
 #include <condition_variable>
 #include <climits>
 #include <cstdlib>
+#include <functional>
 #include "mainwindow.h"
 #include "ControlThread.hpp"
 #include "memorypacket.hpp"
 #include "mux.hpp"
-#include "tile.hpp"
 #include "memory.hpp"
+#include "tile.hpp"
 
 
 #ifndef _PROCESSOR_CLASS_
@@ -37,7 +39,6 @@ static const uint64_t BITMAP_BYTES = 16;
 static const uint64_t BITMAP_SHIFT = 4;
 static const uint64_t BITMAP_MASK = 0xFFFFFFFFFFFFFFF0;
 //page mappings
-static const uint64_t PAGETABLESLOCAL = 0xA000000000000000;
 static const uint64_t GLOBALCLOCKSLOW = 1;
 static const uint64_t TOTAL_LOCAL_PAGES = TILE_MEM_SIZE >> PAGE_SHIFT;
 static const uint64_t BITS_PER_BYTE = 8;
@@ -45,6 +46,19 @@ static const uint64_t BITS_PER_BYTE = 8;
 #define fetchAddressWrite fetchAddressRead
 
 class Tile;
+class ProcessorState;
+
+//a split transaction in flight, and what to do with its data when the
+//tree brings it back
+class Transaction {
+public:
+	MemoryPacket *packet;
+	std::function<void(const MemoryPacket&)> onComplete;
+	//the answer lands here - back to the spares once it is read
+	std::vector<uint8_t> buffer;
+	//the tile is stopped until this one is in
+	bool awaited;
+};
 
 class Processor: public QObject {
     Q_OBJECT
@@ -54,7 +68,8 @@ signals:
     void smallFault();
 
 private:
-	std::mutex interruptLock;
+	//a flag for the same reason as the barrier's cheat lock
+	std::atomic<bool> interruptLock;
 	std::mutex waitMutex;
 	std::vector<uint64_t> registerFile;
 	std::vector<std::tuple<uint64_t, uint64_t, bool>> tlbs;
@@ -77,6 +92,10 @@ private:
 	bool inInterrupt;
 	bool inClock;
 	bool clockDue;
+	bool cheatHeld;
+	void sleepThrough(uint64_t tick, const bool stretch);
+	void lockInterrupt();
+	void unlockInterrupt();
 	void markUpBasicPageEntries(const uint64_t& reqPTEPages,
 	const uint64_t& reqBitmapPages);
 	void writeOutBasicPageEntries(const uint64_t& reqPTEPages);
@@ -114,10 +133,9 @@ private:
         const uint64_t& address);
 	void fixTLB(const uint64_t& frameNo,
 	const uint64_t& address);
-	const std::vector<uint8_t>
-		requestRemoteMemory(
+	void requestRemoteMemory(
 		const uint64_t& size, const uint64_t& remoteAddress,
-		const uint64_t& localAddress);
+		const uint64_t& localAddress, uint8_t *into);
     	const std::pair<uint64_t, uint8_t>
         mapToGlobalAddress(const uint64_t& address);
 	void activateClock();
@@ -126,6 +144,19 @@ private:
     	const uint16_t clockTicks = 40000;
 	uint64_t totalTicks;
 	uint64_t currentTLB;
+	//split transactions - 0 deep means every request blocks the tile
+	uint64_t outstandingDepth;
+	std::vector<Transaction> outstanding;
+	//answers land in these, not in buffers of the packets' own - a
+	//blocking fill in staging, split ones in spares that are reused
+	std::vector<uint8_t> staging;
+	std::vector<std::vector<uint8_t>> spareBuffers;
+	std::vector<uint8_t> takeBuffer(const uint64_t& size);
+	void issueRemote(const uint64_t& size, const uint64_t& remoteAddress,
+		const uint64_t& localAddress,
+		const std::function<void(const MemoryPacket&)>& onComplete,
+		const bool& wait);
+	void collectRemote();
 
 public:
 	std::bitset<16> statusWord;
@@ -134,7 +165,8 @@ public:
 	void switchModeReal();
 	void switchModeVirtual();
 	void setMode();
-	void createMemoryMap(Memory *local, long pShift);
+	void createMemoryMap(Memory *local, long pShift,
+		const bool writeTables = true);
 	void setPCNull();
 	void start();
 	void pcAdvance(const long count = sizeof(long));
@@ -168,6 +200,14 @@ public:
        		const uint64_t& size);
 	void waitATick();
 	void waitGlobalTick();
+	void sleepUntil(const uint64_t& tick);
+	void sleepFor(const uint64_t& count);
+	bool parkForHandoff(MemoryPacket& packet);
+	void setOutstanding(const uint64_t& depth) { outstandingDepth = depth; }
+	void drainRemote();
+	void sendMessage(const uint64_t& destination,
+		const std::vector<uint64_t>& words);
+	const std::vector<uint64_t> receiveMessage();
 	Tile* getTile() const { return masterTile; }
    	uint64_t getNumber() { return processorNumber; }
    	void flushPagesStart();
@@ -176,7 +216,30 @@ public:
     	void dumpPageFromTLB(const uint64_t& address);
     	const uint64_t& getTicks() const { return totalTicks; }
 	void incrementBlocks() const;
-	bool tryCheatLock() const;
-	void cheatUnlock() const;
+	bool tryCheatLock();
+	void cheatUnlock();
+	void keepUndoLog();
+	void forgetUndoBefore(const uint64_t& mark);
+	void saveState(ProcessorState& state) const;
+	void restoreState(const ProcessorState& state);
+};
+
+//what a Time Warp checkpoint needs to put a processor back
+class ProcessorState {
+public:
+	std::vector<uint64_t> registerFile;
+	std::vector<std::tuple<uint64_t, uint64_t, bool>> tlbs;
+	std::bitset<16> statusWord;
+	bool carryBit;
+	uint64_t programCounter;
+	bool realMode;
+	uint64_t stackPointer;
+	bool inInterrupt;
+	bool inClock;
+	bool clockDue;
+	bool cheatHeld;
+	uint64_t totalTicks;
+	uint64_t currentTLB;
+	uint64_t undoMark;
 };
 #endif
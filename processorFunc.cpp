@@ -11,11 +11,12 @@
 #include "ControlThread.hpp"
 #include "memorypacket.hpp"
 #include "mux.hpp"
-#include "noc.hpp"
 #include "memory.hpp"
+#include "noc.hpp"
 #include "tile.hpp"
 #include "processor.hpp"
 #include "processorFunc.hpp"
+#include "mesh.hpp"
 
 using namespace std;
 
@@ -25,6 +26,8 @@ const uint64_t ProcessorFunctor::sumCount = 0x101;
 static const uint64_t BITMAP_FILTER = 0xFFFFFFFFFFFFFFFF;
 //alter to adjust for page size
 static const uint64_t PAGE_ADDRESS_MASK = 0xFFFFFFFFFFFFFC00;
+//integer division stalls the pipeline
+static const uint64_t DIVISION_TICKS = 32;
 
 //Number format
 //numerator
@@ -172,9 +175,7 @@ void ProcessorFunctor::div_(const uint64_t& regA,
     const uint64_t& regB, const uint64_t& regC) const
 {
     proc->setRegister(regA, proc->getRegister(regB) / proc->getRegister(regC));
-    for (int i = 0; i < 32; i++) {
-        proc->waitATick();
-    }
+    proc->sleepFor(DIVISION_TICKS);
     proc->pcAdvance();
 }
 
@@ -183,9 +184,7 @@ void ProcessorFunctor::divi_(const uint64_t& regA,
 {
     proc->pcAdvance();
     proc->setRegister(regA, proc->getRegister(regB) / imm);
-    for (int i = 0; i < 32; i++) {
-        proc->waitATick();
-    }
+    proc->sleepFor(DIVISION_TICKS);
     proc->pcAdvance();
 }
 
@@ -961,12 +960,27 @@ now_for_normalise:
     dropPage();
     pop_(REG15);
     pop_(REG1);
+    if (masterTile->getMesh()) {
+        //tell the waiting tiles directly too
+        add_(REG3, REG0, REG15);
+        ori_(REG3, REG3, 0xFE00);
+        for (uint64_t i = 0; i < SETSIZE &&
+            i < masterTile->getMesh()->tileCount(); i++) {
+            if (i != order) {
+                proc->sendMessage(i,
+                    vector<uint64_t>(1, proc->getRegister(REG3)));
+            }
+        }
+    }
     br_(0);
     goto prepare_to_normalise_next;
 
 wait_for_next_signal:
     cout << "Processor " << proc->getNumber() << " now waiting." << endl;
     push_(REG15);
+    if (masterTile->getMesh()) {
+        goto wait_on_mesh;
+    }
     //try a back off
     addi_(REG5, REG0, 0x40);
     addi_(REG6, REG0, 0x1000);
@@ -1015,6 +1029,19 @@ back_off_reset:
     addi_(REG5, REG0, 0x10);
     goto wait_on_zero;
 
+wait_on_mesh:
+    //no polling - the signal comes to us
+    proc->setRegister(REG4, proc->receiveMessage()[0]);
+    push_(REG4);
+    andi_(REG4, REG4, 0xFF00);
+    addi_(REG8, REG0, 0xFE00);
+    if (beq_(REG8, REG4, 0)) {
+        goto calculate_next;
+    }
+    pop_(REG4);
+    br_(0);
+    goto wait_on_mesh;
+
 calculate_next:
     pop_(REG4);
     andi_(REG4, REG4, 0xFF);
@@ -1022,6 +1049,9 @@ calculate_next:
 	goto on_to_next_round;
     }
     br_(0);
+    if (masterTile->getMesh()) {
+        goto wait_on_mesh;
+    }
     goto wait_on_zero;
 
 on_to_next_round:
@@ -1183,6 +1213,7 @@ completed_wait:
     flushSelectedPage();
     cout << proc->getNumber() << ": our work here is done" << endl;
     cout << "Ticks: " << proc->getTicks() << endl;
+    proc->drainRemote();
     masterTile->getBarrier()->decrementTaskCount();
  }  
 
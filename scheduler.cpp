@@ -0,0 +1,327 @@
+#include <ucontext.h>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+#include "mainwindow.h"
+#include "ControlThread.hpp"
+#include "memorypacket.hpp"
+#include "mux.hpp"
+#include "memory.hpp"
+#include "tile.hpp"
+#include "processor.hpp"
+#include "processorFunc.hpp"
+#include "scheduler.hpp"
+#include "warp.hpp"
+
+using namespace std;
+
+//the fiber this worker thread is running - null outside a fiber
+static thread_local TileFiber *currentFiber = nullptr;
+
+TileFiber::TileFiber(Tile *tile):
+	returnContext(nullptr), stack(FIBER_STACK_SIZE),
+	functor(new ProcessorFunctor(tile)), finished(false), sleepFor(1),
+	request(RUN), stackLow(nullptr), order(tile->getOrder())
+{
+	getcontext(&context);
+	context.uc_stack.ss_sp = stack.data();
+	context.uc_stack.ss_size = stack.size();
+	context.uc_link = nullptr;
+	makecontext(&context, &TileFiber::entry, 0);
+}
+
+TileFiber::~TileFiber()
+{
+	delete functor;
+}
+
+void TileFiber::entry()
+{
+	TileFiber *fiber = currentFiber;
+	(*fiber->functor)();
+	fiber->finished = true;
+	fiber->yield();
+}
+
+//run the fiber until it next waits on a tick (or finishes)
+void TileFiber::resume(ucontext_t *from)
+{
+	returnContext = from;
+	currentFiber = this;
+	swapcontext(from, &context);
+	currentFiber = nullptr;
+}
+
+//ticks - how many barrier passes before the fiber wants to run again
+void TileFiber::yield(const uint64_t& ticks, const FiberRequest req)
+{
+	volatile char marker = 0;
+	stackLow = (char *)&marker;
+	sleepFor = ticks;
+	request = req;
+	swapcontext(&context, returnContext);
+}
+
+//copy the live part of a yielded fiber's stack
+void TileFiber::saveStack(vector<char>& copy, uint64_t& offset,
+	ucontext_t& saved) const
+{
+	offset = 0;
+	if (stackLow - stack.data() > (long)FIBER_STACK_MARGIN) {
+		offset = stackLow - stack.data() - FIBER_STACK_MARGIN;
+	}
+	copy.assign(stack.begin() + offset, stack.end());
+	saved = context;
+}
+
+//the fiber will next run from where saveStack found it
+void TileFiber::loadStack(const vector<char>& copy, const uint64_t& offset,
+	const ucontext_t& saved)
+{
+	copy_n(copy.begin(), copy.size(), stack.begin() + offset);
+	context = saved;
+	finished = false;
+}
+
+TileScheduler::TileScheduler(ControlThread *barrier,
+	const unsigned long workerCount, TimeWarp *warp):
+	pBarrier(barrier), timeWarp(warp), workers(workerCount),
+	liveFibers(0)
+{
+	if (timeWarp) {
+		timeWarp->attachScheduler(this);
+	}
+}
+
+TileScheduler::~TileScheduler()
+{
+	for (auto x: fibers) {
+		delete x;
+	}
+}
+
+//tiles are dealt out round robin - stealing evens out the load
+void TileScheduler::addTile(Tile *tile)
+{
+	TileFiber *fiber = new TileFiber(tile);
+	workers[fibers.size() % workers.size()].ranThisTick.push_back(fiber);
+	fibers.push_back(fiber);
+	liveFibers++;
+	if (timeWarp) {
+		timeWarp->attach(fiber, tile->tileProcessor);
+	}
+}
+
+//a straggler rolled back a tile that had already finished
+void TileScheduler::revive(TileFiber *fiber)
+{
+	TileWorker& worker = workers[fiber->getOrder() % workers.size()];
+	unique_lock<mutex> lck(worker.queueLock);
+	worker.runQueue.push_front(fiber);
+}
+
+TileFiber* TileScheduler::takeOwn(TileWorker& worker)
+{
+	unique_lock<mutex> lck(worker.queueLock);
+	if (worker.runQueue.empty()) {
+		return nullptr;
+	}
+	TileFiber *fiber = worker.runQueue.back();
+	worker.runQueue.pop_back();
+	return fiber;
+}
+
+//take from the cold end of another worker's queue
+TileFiber* TileScheduler::steal(const unsigned long thief)
+{
+	for (unsigned long i = 1; i < workers.size(); i++) {
+		TileWorker& victim = workers[(thief + i) % workers.size()];
+		unique_lock<mutex> lck(victim.queueLock);
+		if (!victim.runQueue.empty()) {
+			TileFiber *fiber = victim.runQueue.front();
+			victim.runQueue.pop_front();
+			return fiber;
+		}
+	}
+	return nullptr;
+}
+
+//sleeping fibers whose tick has come go to whoever gets here first
+void TileScheduler::wakeFibers(TileWorker& worker, const uint64_t& tick)
+{
+	unique_lock<mutex> lck(sleepLock);
+	while (!sleeping.empty() && sleeping.top().first <= tick) {
+		worker.queueLock.lock();
+		worker.runQueue.push_back(sleeping.top().second);
+		worker.queueLock.unlock();
+		sleeping.pop();
+	}
+}
+
+//in quanta from now
+uint64_t TileScheduler::nextWake(const uint64_t& tick)
+{
+	unique_lock<mutex> lck(sleepLock);
+	const uint64_t quantum = pBarrier->getQuantum();
+	//a parked fiber can be woken by any tick's commit, and every commit
+	//has to run while the trees carry split packets
+	if (sleeping.empty() || sleeping.top().first <= tick + quantum ||
+		pBarrier->getParked() > 0 || pBarrier->getInFlight() > 0) {
+		return 1;
+	}
+	return (sleeping.top().first - tick) / quantum;
+}
+
+void TileScheduler::workerLoop(const unsigned long index)
+{
+	TileWorker& worker = workers[index];
+	while (liveFibers.load() > 0) {
+		const uint64_t tick = pBarrier->getTicks();
+		//every fiber this worker ran last tick is its work this tick
+		worker.queueLock.lock();
+		worker.runQueue.assign(worker.ranThisTick.begin(),
+			worker.ranThisTick.end());
+		worker.queueLock.unlock();
+		worker.ranThisTick.clear();
+		wakeFibers(worker, tick);
+		TileFiber *fiber;
+		while ((fiber = takeOwn(worker)) || (fiber = steal(index))) {
+			fiber->resume(&worker.context);
+			if (fiber->isFinished()) {
+				liveFibers--;
+			} else if (fiber->getRequest() == TileFiber::PARK) {
+				//the commit that hands it a buffer wakes it
+				continue;
+			} else if (fiber->getSleep() > 1) {
+				unique_lock<mutex> lck(sleepLock);
+				sleeping.push(make_pair(tick + fiber->getSleep() *
+					pBarrier->getQuantum(), fiber));
+			} else {
+				worker.ranThisTick.push_back(fiber);
+			}
+		}
+		//one arrival covers every tile this worker ran - if we have
+		//none awake, sleep until the first fiber wakes
+		if (worker.ranThisTick.empty()) {
+			pBarrier->sleepTicks(nextWake(tick));
+		} else {
+			pBarrier->releaseToRun();
+		}
+	}
+	pBarrier->decrementTaskCount();
+}
+
+//no barrier - run whatever is queued, round robin, until every tile has
+//finished and no straggler can bring one back
+void TileScheduler::warpLoop(const unsigned long index)
+{
+	TileWorker& worker = workers[index];
+	while (!timeWarp->done()) {
+		TileFiber *fiber;
+		if (!(fiber = takeOwn(worker)) && !(fiber = steal(index))) {
+			timeWarp->collect();
+			this_thread::yield();
+			continue;
+		}
+		if (fiber->isFinished()) {
+			timeWarp->restore(fiber);
+		}
+		bool running = true;
+		while (running) {
+			fiber->resume(&worker.context);
+			switch (fiber->getRequest()) {
+			case TileFiber::CHECKPOINT:
+				timeWarp->saveStack(fiber);
+				break;
+			case TileFiber::ROLLBACK:
+				timeWarp->restore(fiber);
+				break;
+			default:
+				running = false;
+			}
+		}
+		if (!fiber->isFinished() || !timeWarp->finish(fiber)) {
+			worker.queueLock.lock();
+			worker.runQueue.push_front(fiber);
+			worker.queueLock.unlock();
+		}
+		timeWarp->collect();
+	}
+}
+
+void TileScheduler::execute()
+{
+	vector<thread> threads;
+	if (timeWarp) {
+		for (unsigned long i = 0; i < workers.size(); i++) {
+			workers[i].runQueue.assign(
+				workers[i].ranThisTick.begin(),
+				workers[i].ranThisTick.end());
+			workers[i].ranThisTick.clear();
+		}
+		for (unsigned long i = 0; i < workers.size(); i++) {
+			threads.push_back(thread(&TileScheduler::warpLoop,
+				this, i));
+		}
+		for (auto& t: threads) {
+			t.join();
+		}
+		return;
+	}
+	for (unsigned long i = 0; i < workers.size(); i++) {
+		pBarrier->incrementTaskCount();
+	}
+	for (unsigned long i = 0; i < workers.size(); i++) {
+		threads.push_back(thread(&TileScheduler::workerLoop, this, i));
+	}
+	for (auto& t: threads) {
+		t.join();
+	}
+}
+
+bool TileScheduler::inFiber()
+{
+	return currentFiber != nullptr;
+}
+
+//hand the tick back to the worker - it arrives at the barrier for us
+void TileScheduler::yieldTick()
+{
+	currentFiber->yield();
+}
+
+void TileScheduler::sleepTicks(const uint64_t& count)
+{
+	currentFiber->yield(count);
+}
+
+//off every queue until wakeFiber
+void TileScheduler::parkFiber(ParkedTile& parked)
+{
+	parked.fiber = currentFiber;
+	currentFiber->yield(1, TileFiber::PARK);
+}
+
+//called by the barrier thread mid commit - no worker is running
+void TileScheduler::wakeFiber(TileFiber *fiber, const uint64_t& tick)
+{
+	unique_lock<mutex> lck(sleepLock);
+	sleeping.push(make_pair(tick, fiber));
+}
+
+//our worker copies the stack - a rollback comes back to this call
+void TileScheduler::checkpointFiber()
+{
+	currentFiber->yield(1, TileFiber::CHECKPOINT);
+}
+
+//our worker puts back the stack of the checkpoint we roll back to
+void TileScheduler::rollbackFiber()
+{
+	currentFiber->yield(1, TileFiber::ROLLBACK);
+}
@@ -0,0 +1,98 @@
+//M:N tile scheduler - tiles run as fibers on a pool of worker threads
+#include <ucontext.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include <utility>
+
+#ifndef _SCHEDULER_CLASS_
+#define _SCHEDULER_CLASS_
+
+static const uint64_t FIBER_STACK_SIZE = 256 * 1024;
+//below the deepest live frame we know of when a fiber yields
+static const uint64_t FIBER_STACK_MARGIN = 1024;
+
+class Tile;
+class ControlThread;
+class ProcessorFunctor;
+class TimeWarp;
+class ParkedTile;
+
+class TileFiber {
+public:
+	//what the fiber wants from its worker when it yields
+	enum FiberRequest { RUN, CHECKPOINT, ROLLBACK, PARK };
+
+private:
+	ucontext_t context;
+	ucontext_t *returnContext;
+	std::vector<char> stack;
+	ProcessorFunctor *functor;
+	bool finished;
+	uint64_t sleepFor;
+	FiberRequest request;
+	char *stackLow;
+	const unsigned long order;
+	static void entry();
+
+public:
+	TileFiber(Tile *tile);
+	~TileFiber();
+	void resume(ucontext_t *from);
+	void yield(const uint64_t& ticks = 1, const FiberRequest req = RUN);
+	bool isFinished() const { return finished; }
+	uint64_t getSleep() const { return sleepFor; }
+	FiberRequest getRequest() const { return request; }
+	unsigned long getOrder() const { return order; }
+	void saveStack(std::vector<char>& copy, uint64_t& offset,
+		ucontext_t& saved) const;
+	void loadStack(const std::vector<char>& copy, const uint64_t& offset,
+		const ucontext_t& saved);
+};
+
+class TileWorker {
+public:
+	std::mutex queueLock;
+	std::deque<TileFiber *> runQueue;
+	std::vector<TileFiber *> ranThisTick;
+	ucontext_t context;
+};
+
+class TileScheduler {
+private:
+	ControlThread *pBarrier;
+	TimeWarp *timeWarp;
+	std::vector<TileWorker> workers;
+	std::vector<TileFiber *> fibers;
+	std::atomic<long> liveFibers;
+	//fibers asleep until a future tick - earliest wake on top
+	std::mutex sleepLock;
+	std::priority_queue<std::pair<uint64_t, TileFiber *>,
+		std::vector<std::pair<uint64_t, TileFiber *>>,
+		std::greater<std::pair<uint64_t, TileFiber *>>> sleeping;
+	void workerLoop(const unsigned long index);
+	void warpLoop(const unsigned long index);
+	TileFiber* takeOwn(TileWorker& worker);
+	TileFiber* steal(const unsigned long thief);
+	void wakeFibers(TileWorker& worker, const uint64_t& tick);
+	uint64_t nextWake(const uint64_t& tick);
+
+public:
+	TileScheduler(ControlThread *barrier, const unsigned long workerCount,
+		TimeWarp *warp = nullptr);
+	~TileScheduler();
+	void addTile(Tile *tile);
+	void revive(TileFiber *fiber);
+	void wakeFiber(TileFiber *fiber, const uint64_t& tick);
+	void execute();
+	static bool inFiber();
+	static void yieldTick();
+	static void sleepTicks(const uint64_t& count);
+	static void parkFiber(ParkedTile& parked);
+	static void checkpointFiber();
+	static void rollbackFiber();
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "memory.hpp"
+#include "snapshot.hpp"
+
+using namespace std;
+
+bool SnapshotKey::operator==(const SnapshotKey& other) const
+{
+	return columns == other.columns && rows == other.rows &&
+		pageShift == other.pageShift && blocks == other.blocks &&
+		blockSize == other.blockSize &&
+		interleaveShift == other.interleaveShift &&
+		tileMemory == other.tileMemory &&
+		variables == other.variables;
+}
+
+//map the file if it is there and was made for this run
+Snapshot::Snapshot(const string& file, const SnapshotKey& wanted):
+	path(file), key(wanted), fd(-1), image(nullptr), imageSize(0),
+	matched(false)
+{
+	fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 ||
+		(uint64_t)fileStat.st_size < sizeof(SnapshotHeader)) {
+		cerr << "Snapshot " << path << " is unreadable" << endl;
+		return;
+	}
+	imageSize = fileStat.st_size;
+	void *mapping = mmap(nullptr, imageSize, PROT_READ, MAP_PRIVATE,
+		fd, 0);
+	if (mapping == MAP_FAILED) {
+		cerr << "Snapshot " << path << " could not be mapped" << endl;
+		image = nullptr;
+		return;
+	}
+	image = (uint8_t *)mapping;
+	memcpy(&header, image, sizeof(SnapshotHeader));
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) ||
+		header.version != SNAPSHOT_VERSION) {
+		cerr << "Snapshot " << path << " is not a version ";
+		cerr << SNAPSHOT_VERSION << " snapshot" << endl;
+		return;
+	}
+	if (!(header.key == key)) {
+		cerr << "Snapshot " << path << " was made for another ";
+		cerr << "system - rebuilding it" << endl;
+		return;
+	}
+	if (sizeof(SnapshotHeader) + header.runCount * sizeof(SnapshotRun) >
+		imageSize) {
+		cerr << "Snapshot " << path << " is truncated" << endl;
+		return;
+	}
+	for (uint32_t i = 0; i < header.runCount; i++) {
+		if (runs()[i].fileOffset + runs()[i].size > imageSize) {
+			cerr << "Snapshot " << path << " is truncated" << endl;
+			return;
+		}
+	}
+	matched = true;
+}
+
+Snapshot::~Snapshot()
+{
+	if (image) {
+		munmap(image, imageSize);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+void Snapshot::restore(const uint64_t& owner, Memory& memory) const
+{
+	for (uint32_t i = 0; i < header.runCount; i++) {
+		const SnapshotRun& run = runs()[i];
+		if (run.owner == owner) {
+			memory.mapImage(fd, run.fileOffset,
+				image + run.fileOffset, run.offset, run.size);
+		}
+	}
+}
+
+void Snapshot::restoreGlobal(GlobalMemory& global) const
+{
+	for (unsigned long i = 0; i < global.channelCount(); i++) {
+		restore(i, global.channel(i));
+	}
+}
+
+void Snapshot::restoreLocal(const unsigned long tile, Memory& local) const
+{
+	restore(SNAPSHOT_TILE | tile, local);
+}
+
+//written aside and renamed, so a process mapping the old file is safe
+void Snapshot::save(GlobalMemory& global, const vector<Memory *>& locals,
+	const uint64_t& basePageTables) const
+{
+	vector<SnapshotRun> table;
+	vector<Memory *> owners;
+	vector<pair<uint64_t, uint64_t>> found;
+	for (unsigned long i = 0; i < global.channelCount() + locals.size();
+		i++) {
+		const bool tile = i >= global.channelCount();
+		Memory *memory = tile ? locals[i - global.channelCount()] :
+			&global.channel(i);
+		found.clear();
+		memory->imageRuns(found);
+		for (auto& run: found) {
+			SnapshotRun entry;
+			entry.owner = tile ?
+				(SNAPSHOT_TILE | (i - global.channelCount())) : i;
+			entry.offset = run.first;
+			entry.size = run.second;
+			entry.fileOffset = 0;
+			table.push_back(entry);
+			owners.push_back(memory);
+		}
+	}
+	uint64_t fileOffset = sizeof(SnapshotHeader) +
+		table.size() * sizeof(SnapshotRun);
+	for (auto& entry: table) {
+		fileOffset = (fileOffset + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+		entry.fileOffset = fileOffset;
+		fileOffset += entry.size;
+	}
+
+	SnapshotHeader out;
+	memset(&out, 0, sizeof(SnapshotHeader));
+	memcpy(out.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	out.version = SNAPSHOT_VERSION;
+	out.runCount = table.size();
+	out.key = key;
+	out.basePageTables = basePageTables;
+
+	const string partial = path + ".partial";
+	ofstream file(partial, ios::binary | ios::trunc);
+	file.write((const char *)&out, sizeof(SnapshotHeader));
+	file.write((const char *)table.data(),
+		table.size() * sizeof(SnapshotRun));
+	vector<uint8_t> data;
+	for (unsigned long i = 0; i < table.size(); i++) {
+		const uint64_t padding = table[i].fileOffset - file.tellp();
+		data.assign(padding, 0);
+		file.write((const char *)data.data(), padding);
+		data.resize(table[i].size);
+		owners[i]->imageCopy(table[i].offset, data.data(),
+			table[i].size);
+		file.write((const char *)data.data(), table[i].size);
+	}
+	file.close();
+	if (!file || rename(partial.c_str(), path.c_str()) != 0) {
+		cerr << "Could not write snapshot " << path << endl;
+		remove(partial.c_str());
+		return;
+	}
+	cout << "Saved snapshot " << path << ": " << table.size();
+	cout << " runs, " << fileOffset << " bytes" << endl;
+}
+
+//FNV-1a - zero if the file cannot be read
+uint64_t Snapshot::hashFile(const string& file)
+{
+	ifstream input(file, ios::binary);
+	if (!input) {
+		return 0;
+	}
+	uint64_t hash = 0xcbf29ce484222325;
+	char next;
+	while (input.get(next)) {
+		hash ^= (uint8_t)next;
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
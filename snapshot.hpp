@@ -0,0 +1,77 @@
+//Snapshot - global memory and every tile's scratchpad as they stand
+//once set up is done, saved so that a run with the same parameters
+//and variables maps it instead of building the page tables again
+#include <string>
+#include <vector>
+
+#ifndef _SNAPSHOT_CLASS_
+#define _SNAPSHOT_CLASS_
+
+static const char SNAPSHOT_MAGIC[8] = "NOCSNAP";
+static const uint32_t SNAPSHOT_VERSION = 1;
+//run owners at or above this are tiles, below are global channels
+static const uint64_t SNAPSHOT_TILE = 1UL << 63;
+
+class Memory;
+class GlobalMemory;
+
+//everything the image depends on - a snapshot that differs is rebuilt
+class SnapshotKey {
+public:
+	uint64_t columns;
+	uint64_t rows;
+	uint64_t pageShift;
+	uint64_t blocks;
+	uint64_t blockSize;
+	uint64_t interleaveShift;
+	uint64_t tileMemory;
+	//hash of the variables file
+	uint64_t variables;
+	bool operator==(const SnapshotKey& other) const;
+};
+
+class SnapshotHeader {
+public:
+	char magic[8];
+	uint32_t version;
+	uint32_t runCount;
+	SnapshotKey key;
+	uint64_t basePageTables;
+};
+
+//a run of non-zero host pages - data is page aligned in the file so
+//it can be mapped where it belongs
+class SnapshotRun {
+public:
+	uint64_t owner;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t fileOffset;
+};
+
+class Snapshot {
+private:
+	const std::string path;
+	const SnapshotKey key;
+	int fd;
+	uint8_t *image;
+	uint64_t imageSize;
+	SnapshotHeader header;
+	bool matched;
+	const SnapshotRun* runs() const
+		{ return (const SnapshotRun *)(image + sizeof(SnapshotHeader)); }
+	void restore(const uint64_t& owner, Memory& memory) const;
+
+public:
+	Snapshot(const std::string& file, const SnapshotKey& wanted);
+	~Snapshot();
+	bool matches() const { return matched; }
+	uint64_t getBasePageTables() const { return header.basePageTables; }
+	void restoreGlobal(GlobalMemory& global) const;
+	void restoreLocal(const unsigned long tile, Memory& local) const;
+	void save(GlobalMemory& global, const std::vector<Memory *>& locals,
+		const uint64_t& basePageTables) const;
+	static uint64_t hashFile(const std::string& file);
+};
+
+#endif
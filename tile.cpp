@@ -15,18 +15,20 @@
 #include "tile.hpp"
 #include "processor.hpp"
 #include "noc.hpp"
+#include "arbiter.hpp"
 
 
 using namespace std;
 
 Tile::Tile(Noc* n, const long c, const long r, const long pShift,
-	MainWindow *mW, uint64_t numb):
+	MainWindow *mW, uint64_t numb, const bool buildTables):
 	tileLocalMemory{new Memory(0, TILE_MEM_SIZE)},
+	globalMemory{nullptr},
     	coordinates{pair<const long, const long>(c, r)}, parentBoard{n},
     	mainWindow(mW)
 {
     	tileProcessor = new Processor(this, mainWindow, numb);
-	tileProcessor->createMemoryMap(tileLocalMemory, pShift);
+	tileProcessor->createMemoryMap(tileLocalMemory, pShift, buildTables);
 }
 
 Tile::~Tile()
@@ -41,79 +43,36 @@ void Tile::addConnection(const long col, const long row)
 	connections.push_back(pair<long, long>(col, row));
 }
 
-void Tile::addTreeLeaf(Mux *leaf)
+//null unless the analytic model stands in for, or checks, the trees
+NetworkModel* Tile::modelFor(const uint64_t& address) const
 {
-	treeLeaf = leaf;
-}
-
-unsigned long Tile::getOrder() const
-{
-	long row = coordinates.first;
-	long column = coordinates.second;
-	return (row * parentBoard->getColumnCount()) + column;
-}
-
-uint8_t Tile::readByte(const uint64_t& address) const
-{
-	if (address < PAGETABLESLOCAL || address > PAGETABLESLOCAL +
-		tileLocalMemory->getSize() - 1) {
-		return (parentBoard->getGlobal())[0].readByte(address);
-	} else {
-		return tileLocalMemory->readByte(address - PAGETABLESLOCAL);
+	if (parentBoard->models.empty()) {
+		return nullptr;
 	}
+	return parentBoard->models[globalMemory->channelOf(address)];
 }
 
-
-uint64_t Tile::readLong(const uint64_t& address) const
+Mesh* Tile::getMesh() const
 {
-	if (address < PAGETABLESLOCAL || address > PAGETABLESLOCAL +
-		tileLocalMemory->getSize() - 1) {
-		return (parentBoard->getGlobal())[0].readLong(address);
-	} else {
-		return tileLocalMemory->readLong(address - PAGETABLESLOCAL);
-	}
-}
-	
-uint32_t Tile::readWord32(const uint64_t& address) const
-{
-	if (address < PAGETABLESLOCAL || address > PAGETABLESLOCAL +
-		tileLocalMemory->getSize() - 1) {
-		return (parentBoard->getGlobal())[0].readWord32(address);
-	} else {
-		return tileLocalMemory->readWord32(address - PAGETABLESLOCAL);
-	}
+	return parentBoard->mesh;
 }
 
-void Tile::writeWord32(const uint64_t& address, const uint32_t& value) const
+//one packet's ticks from asking to having its data
+void Tile::recordTrip(const uint64_t& ticks) const
 {
-	if (address < PAGETABLESLOCAL || address > PAGETABLESLOCAL +
-		tileLocalMemory->getSize() - 1) {
-		(parentBoard->getGlobal())[0].writeWord32(address, value);
-	} else {
-		tileLocalMemory->writeWord32(address - PAGETABLESLOCAL, value);
-	}
+	parentBoard->waits[getOrder()]->record(ticks);
 }
 
-void Tile::writeByte(const uint64_t& address, const uint8_t& value) const
+void Tile::addTree(Tree *tree)
 {
-	if (address < PAGETABLESLOCAL || address > PAGETABLESLOCAL +
-		tileLocalMemory->getSize() - 1) {
-		(parentBoard->getGlobal())[0].writeByte(address, value);
-	} else {
-		tileLocalMemory->writeByte(address - PAGETABLESLOCAL, value);
-	}
+	trees.push_back(tree);
 }
 
-void Tile::writeLong(const uint64_t& address, const uint64_t& value)
-	const
+unsigned long Tile::getOrder() const
 {
-	if (address < PAGETABLESLOCAL || address >= PAGETABLESLOCAL +
-		tileLocalMemory->getSize()) {
-		(parentBoard->getGlobal())[0].writeLong(address, value);
-	} else {
-		return tileLocalMemory->writeLong(address - PAGETABLESLOCAL,
-			value);
-	}
+	long row = coordinates.first;
+	long column = coordinates.second;
+	return (row * parentBoard->getColumnCount()) + column;
 }
 
 ControlThread* Tile::getBarrier()
@@ -4,39 +4,134 @@
 #define _TILE_CLASS_
 #include <QString>
 
+//local memory is mapped in here - everything else is global
+static const uint64_t PAGETABLESLOCAL = 0xA000000000000000;
+
 class Memory;
+class GlobalMemory;
 class Processor;
 class Noc;
+class NetworkModel;
+class Mesh;
+class Tree;
 
 class Tile
 {
 private:
 	Memory *tileLocalMemory;
+	GlobalMemory *globalMemory;
+	//one Mux tree per channel
+	std::vector<Tree *> trees;
 	const std::pair<const long, const long> coordinates;
 	std::vector<std::pair<long, long> > connections;
 	Noc *parentBoard;
     MainWindow *mainWindow;
 
+	bool isLocal(const uint64_t& address) const
+		{ return address - PAGETABLESLOCAL < TILE_MEM_SIZE; }
+
 public:
     Tile(Noc* parent, const long col, const long r, const long pShift,
-         MainWindow *mW, uint64_t numb);
+         MainWindow *mW, uint64_t numb, const bool buildTables = true);
 	~Tile();
-	Mux *treeLeaf;
 	Processor *tileProcessor;
-	void addTreeLeaf(Mux* leaf);
+	void addTree(Tree* tree);
+	Tree* treeFor(const uint64_t& address) const
+		{ return trees[globalMemory->channelOf(address)]; }
+	NetworkModel* modelFor(const uint64_t& address) const;
 	void addConnection(const long col, const long row);
+	const std::vector<std::pair<long, long> >& getConnections() const
+		{ return connections; }
+	Mesh* getMesh() const;
+	void recordTrip(const uint64_t& ticks) const;
     unsigned long getOrder() const;
     long getRow() const {return coordinates.second;}
     long getColumn() const { return coordinates.first;}
+	void mapGlobal(GlobalMemory *global) { globalMemory = global; }
+	GlobalMemory* getGlobal() const { return globalMemory; }
+	Memory* getLocal() const { return tileLocalMemory; }
 
-
-	//memory pass through
-    uint8_t readByte(const uint64_t& address) const;
-    uint64_t readLong(const uint64_t& address) const;
-    uint32_t readWord32(const uint64_t& address) const;
-    void writeWord32(const uint64_t& address, const uint32_t& value) const;
-    void writeByte(const uint64_t& address, const uint8_t& value) const;
-    void writeLong(const uint64_t& address, const uint64_t& value) const;
+	//memory pass through - the scratchpad, or a global channel
+	uint8_t readByte(const uint64_t& address) const {
+		return isLocal(address) ?
+			tileLocalMemory->readByte(address - PAGETABLESLOCAL) :
+			globalMemory->readByte(address);
+	}
+	uint16_t readWord16(const uint64_t& address) const {
+		return isLocal(address) ?
+			tileLocalMemory->readWord16(address - PAGETABLESLOCAL) :
+			globalMemory->readWord16(address);
+	}
+	uint32_t readWord32(const uint64_t& address) const {
+		return isLocal(address) ?
+			tileLocalMemory->readWord32(address - PAGETABLESLOCAL) :
+			globalMemory->readWord32(address);
+	}
+	uint64_t readLong(const uint64_t& address) const {
+		return isLocal(address) ?
+			tileLocalMemory->readLong(address - PAGETABLESLOCAL) :
+			globalMemory->readLong(address);
+	}
+	void writeByte(const uint64_t& address, const uint8_t& value) const {
+		if (isLocal(address)) {
+			tileLocalMemory->writeByte(address - PAGETABLESLOCAL, value);
+		} else {
+			globalMemory->writeByte(address, value);
+		}
+	}
+	void writeWord16(const uint64_t& address, const uint16_t& value)
+		const {
+		if (isLocal(address)) {
+			tileLocalMemory->writeWord16(address - PAGETABLESLOCAL,
+				value);
+		} else {
+			globalMemory->writeWord16(address, value);
+		}
+	}
+	void writeWord32(const uint64_t& address, const uint32_t& value)
+		const {
+		if (isLocal(address)) {
+			tileLocalMemory->writeWord32(address - PAGETABLESLOCAL,
+				value);
+		} else {
+			globalMemory->writeWord32(address, value);
+		}
+	}
+	void writeLong(const uint64_t& address, const uint64_t& value)
+		const {
+		if (isLocal(address)) {
+			tileLocalMemory->writeLong(address - PAGETABLESLOCAL, value);
+		} else {
+			globalMemory->writeLong(address, value);
+		}
+	}
+	void readBlock(const uint64_t& address, uint8_t *out,
+		const uint64_t& size) const {
+		if (isLocal(address)) {
+			tileLocalMemory->readBlock(address - PAGETABLESLOCAL, out,
+				size);
+		} else {
+			globalMemory->readBlock(address, out, size);
+		}
+	}
+	void writeBlock(const uint64_t& address, const uint8_t *in,
+		const uint64_t& size) const {
+		if (isLocal(address)) {
+			tileLocalMemory->writeBlock(address - PAGETABLESLOCAL, in,
+				size);
+		} else {
+			globalMemory->writeBlock(address, in, size);
+		}
+	}
+	void fill(const uint64_t& address, const uint8_t& value,
+		const uint64_t& size) const {
+		if (isLocal(address)) {
+			tileLocalMemory->fill(address - PAGETABLESLOCAL, value,
+				size);
+		} else {
+			globalMemory->fill(address, value, size);
+		}
+	}
 	ControlThread *getBarrier();
 };
 
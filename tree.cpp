@@ -3,7 +3,10 @@
 #include <map>
 #include <mutex>
 #include <bitset>
+#include <tuple>
 #include <condition_variable>
+#include <cstdlib>
+#include <new>
 #include "mainwindow.h"
 #include "ControlThread.hpp"
 #include "memorypacket.hpp"
@@ -13,29 +16,46 @@
 #include "noc.hpp"
 #include "tile.hpp"
 #include "processor.hpp"
+#include "arbiter.hpp"
+#include "ddr.hpp"
+#include "coalesce.hpp"
+#include "muxstats.hpp"
+#include "wormhole.hpp"
 
 
 using namespace std;
 
-Tree::Tree(Memory& globalMemory, Noc& noc, const long columns, const long rows)
+//one tree per memory channel - every tile has a leaf in each
+Tree::Tree(GlobalMemory& globalMemory, const unsigned long channel,
+	Noc& noc, const long columns, const long rows, const long arbitration)
 {
-	long totalLeaves = columns * rows;
+	const uint64_t leafCount = columns * rows / 2;
+	nodeCount = 2 * leafCount - 1;
 	levels = 0;
-	long muxCount = totalLeaves / 2;
-
-	//create the nodes
-	while (muxCount > 1) {
-		nodesTree.push_back(vector<Mux>(muxCount));
-		for (unsigned int i = 0; i < nodesTree[levels].size(); i++){
-			nodesTree[levels][i].assignGlobalMemory(&globalMemory);
-		}
-		muxCount /= 2;
+	while ((1UL << levels) < leafCount) {
 		levels++;
 	}
-	//number the leaves
-	for (unsigned int i = 0; i < nodesTree[0].size(); i++)
+	ddr = nullptr;
+	coalescer = nullptr;
+	stats = nullptr;
+	wormhole = nullptr;
+
+	//create the nodes - one block, the children of node i at 2i + 1
+	//and 2i + 2
+	nodes = (Mux *)aligned_alloc(alignof(Mux), nodeCount * sizeof(Mux));
+	if (!nodes) {
+		cerr << "Tree could not allocate its Muxes" << endl;
+		throw "Tree allocation error";
+	}
+	for (uint64_t i = 0; i < nodeCount; i++) {
+		new (&nodes[i]) Mux();
+		nodes[i].assignGlobalMemory(&globalMemory, channel);
+	}
+	//number the leaves - the last leafCount nodes
+	const uint64_t firstLeaf = leafCount - 1;
+	for (uint64_t i = 0; i < leafCount; i++)
 	{
-		nodesTree[0][i].assignNumbers(
+		nodes[firstLeaf + i].assignNumbers(
 			i * 2, i * 2, i * 2 + 1, i * 2 + 1);
 		Tile *targetTile = noc.tileAt(i * 2);
 		Tile *targetTile2 = noc.tileAt(i * 2 + 1);
@@ -43,42 +63,177 @@ Tree::Tree(Memory& globalMemory, Noc& noc, const long columns, const long rows)
 			cout << "Bad tile index: " << i << endl;
 			throw "tile index error";
 		}
-		targetTile->addTreeLeaf(&(nodesTree[0][i]));
-		targetTile2->addTreeLeaf(&(nodesTree[0][i]));
-	}
-	//root Mux - connects to global memory
-	nodesTree.push_back(vector<Mux>(1));
-	nodesTree[levels][0].assignGlobalMemory(&globalMemory);
-	nodesTree[levels][0].upstreamMux = nullptr;
-	for (int i = 0; i <= levels; i++) {
-		for (unsigned int j = 0; j < nodesTree[i].size(); j++) {
-			if (i > 0) {
-				nodesTree[i][j].downstreamMuxLow = 
-					&(nodesTree[i - 1][j * 2]);
-				nodesTree[i][j].downstreamMuxHigh = 
-					&(nodesTree[i - 1][j * 2 + 1]);
-			}
-			if (i < levels) {
-				nodesTree[i][j].upstreamMux = &(nodesTree[i + 1][j/2]);
-			}
-		}
+		targetTile->addTree(this);
+		targetTile2->addTree(this);
 	}
-	//join the nodes internally
-	for (int i = 0; i < levels; i++)
-	{
-		for (unsigned int j = 0; j < nodesTree[i].size(); j+= 2)
-		{
-			nodesTree[i + 1][j / 2].joinUpMux(
-				nodesTree[i][j], nodesTree[i][j + 1]);
-		}
+	//join the nodes, from the bottom up - the root connects to
+	//global memory
+	nodes[0].upstreamMux = nullptr;
+	for (uint64_t i = firstLeaf; i-- > 0;) {
+		nodes[i].downstreamMuxLow = &nodes[2 * i + 1];
+		nodes[i].downstreamMuxHigh = &nodes[2 * i + 2];
+		nodes[2 * i + 1].upstreamMux = &nodes[i];
+		nodes[2 * i + 2].upstreamMux = &nodes[i];
+		nodes[i].joinUpMux(nodes[2 * i + 1], nodes[2 * i + 2]);
+	}
+	//initialise the mutexes, and give each Mux its arbiter
+	for (uint64_t i = 0; i < nodeCount; i++) {
+		nodes[i].initialiseMutex();
+		const auto numbers = nodes[i].fetchNumbers();
+		nodes[i].setArbiter(Arbiter::create(arbitration,
+			get<1>(numbers) - get<0>(numbers) + 1,
+			get<3>(numbers) - get<2>(numbers) + 1));
 	}
-	//initialise the mutexes
-	for (unsigned int i = 0; i < nodesTree.size(); i++) {
-		for (unsigned int j = 0; j < nodesTree[i].size(); j++) {
-			nodesTree[i][j].initialiseMutex();
+	//every tile's path to the root, worked out once
+	routes.resize(leafCount * 2 * (levels + 1));
+	for (uint64_t tile = 0; tile < leafCount * 2; tile++) {
+		RouteStep *step = &routes[tile * (levels + 1)];
+		uint64_t node = firstLeaf + tile / 2;
+		bool left = (tile % 2 == 0);
+		for (long i = 0; i <= levels; i++) {
+			step[i].node = node;
+			step[i].left = left;
+			left = (node % 2 == 1);
+			node = (node - 1) / 2;
 		}
 	}
 
-	//attach root to global memory
-	globalMemory.attachTree(&(nodesTree.at(nodesTree.size() - 1)[0]));
+	//attach root to its channel
+	globalMemory.channel(channel).attachTree(&nodes[0]);
+}
+
+Tree::~Tree()
+{
+	for (uint64_t i = 0; i < nodeCount; i++) {
+		nodes[i].~Mux();
+	}
+	free(nodes);
+	delete ddr;
+	delete coalescer;
+	delete stats;
+	delete wormhole;
+}
+
+//every Mux in a tree serves the same channel
+bool Tree::acceptPacketUp(const MemoryPacket& packet) const
+{
+	return nodes[0].acceptPacketUp(packet);
+}
+
+const RouteStep* Tree::routeFor(const MemoryPacket& packet) const
+{
+	return &routes[packet.getProcessor()->getTile()->getOrder() *
+		(levels + 1)];
+}
+
+//walk the tile's path - into its leaf, up a Mux at a time, then out of
+//the root to DDR
+void Tree::routePacket(MemoryPacket& packet)
+{
+	const RouteStep *step = routeFor(packet);
+	packet.setIssued(packet.getProcessor()->getTicks());
+	if (wormhole) {
+		nodes[step[0].node].sendFlits(packet);
+		return;
+	}
+	nodes[step[0].node].enterLeaf(packet, step[0].left);
+	for (long i = 0; i < levels; i++) {
+		nodes[step[i].node].postPacketUp(packet, step[i].left,
+			nodes[step[i + 1].node], step[i + 1].left);
+	}
+	nodes[step[levels].node].routeDown(packet, step[levels].left);
+}
+
+void Tree::injectPacket(MemoryPacket& packet)
+{
+	const RouteStep *step = routeFor(packet);
+	nodes[step[0].node].injectPacket(packet, step[0].left);
+}
+
+//a controller in place of the root's flat DDR_DELAY - it runs in the
+//commits, so only in strict mode
+void Tree::attachDDR(const long scheduling, GlobalMemory& globalMemory)
+{
+	ddr = new DDRController(scheduling, globalMemory);
+	nodes[0].setDDR(ddr);
+}
+
+void Tree::reportDDR(const unsigned long channel) const
+{
+	if (ddr) {
+		ddr->report(channel);
+	}
+}
+
+//requests reaching the root wait out the window for neighbours to
+//share a DDR access with
+void Tree::attachCoalescer(const uint64_t& window)
+{
+	coalescer = new Coalescer(window);
+	nodes[0].setCoalescer(coalescer);
+}
+
+void Tree::reportCoalescing(const unsigned long channel) const
+{
+	if (coalescer) {
+		coalescer->report(channel);
+	}
+}
+
+//every Mux counts for both its buffers from here on
+void Tree::attachStats(const uint64_t& window, const unsigned long channel)
+{
+	stats = new MuxStats(window, channel, nodeCount, levels);
+	for (uint64_t i = 0; i < nodeCount; i++) {
+		nodes[i].setStats(stats->sidesOf(i));
+	}
+}
+
+void Tree::writeStats(ostream& out) const
+{
+	if (stats) {
+		stats->write(out);
+	}
+}
+
+//routers in place of the Muxes' buffers - every Mux hands its packets
+//over, and the root takes them back at the top for DDR
+void Tree::attachWormhole(const uint64_t channels, const uint64_t depth,
+	const long arbitration)
+{
+	wormhole = new Wormhole(channels, depth, levels, nodeCount + 1,
+		&routes[0], arbitration);
+	for (uint64_t i = 0; i < nodeCount; i++) {
+		nodes[i].setWormhole(wormhole);
+	}
+}
+
+void Tree::reportWormhole(const unsigned long channel) const
+{
+	if (wormhole) {
+		wormhole->report(channel);
+	}
+}
+
+//second phase of a tick - a level's Muxes only touch their own buffers
+//and the ones above, so each level is settled before the one below -
+//heap order has the levels root first. Responses go the other way
+void Tree::commit(const uint64_t& tick)
+{
+	if (stats) {
+		stats->tick(tick);
+	}
+	if (wormhole) {
+		vector<MemoryPacket *> atRoot;
+		wormhole->tick(tick, atRoot);
+		for (auto packet: atRoot) {
+			nodes[0].offToDDR(packet, tick);
+		}
+	}
+	for (uint64_t i = 0; i < nodeCount; i++) {
+		nodes[i].commit(tick);
+	}
+	for (uint64_t i = nodeCount; i-- > 0;) {
+		nodes[i].commitDown(tick);
+	}
 }
@@ -3,17 +3,56 @@
 
 class Noc;
 class Mux;
-class Memory;
+class GlobalMemory;
+class DDRController;
+class Coalescer;
+class MuxStats;
+class Wormhole;
+class MemoryPacket;
+
+//a tile's place at one level of a tree - the Mux, by its index, and
+//which of that Mux's buffers the tile's packets take
+class RouteStep {
+public:
+	uint64_t node;
+	bool left;
+};
 
 class Tree {
 
 private:
-	std::vector<std::vector<Mux>> nodesTree;
+	//every Mux in heap order - the root, then each level below it left
+	//to right, the leaves last
+	Mux *nodes;
+	uint64_t nodeCount;
 	long levels;
-	
+	//levels + 1 steps a tile, leaf first
+	std::vector<RouteStep> routes;
+	//at the root, when DDR is modelled
+	DDRController *ddr;
+	Coalescer *coalescer;
+	MuxStats *stats;
+	Wormhole *wormhole;
+	const RouteStep* routeFor(const MemoryPacket& packet) const;
 
 public:
-	Tree(Memory& globalMemory, Noc& noc,
-		const long columns, const long rows);
+	Tree(GlobalMemory& globalMemory, const unsigned long channel,
+		Noc& noc, const long columns, const long rows,
+		const long arbitration = 0);
+	~Tree();
+	long getLevels() const { return levels; }
+	void commit(const uint64_t& tick);
+	bool acceptPacketUp(const MemoryPacket& packet) const;
+	void routePacket(MemoryPacket& packet);
+	void injectPacket(MemoryPacket& packet);
+	void attachDDR(const long scheduling, GlobalMemory& globalMemory);
+	void reportDDR(const unsigned long channel) const;
+	void attachCoalescer(const uint64_t& window);
+	void reportCoalescing(const unsigned long channel) const;
+	void attachStats(const uint64_t& window, const unsigned long channel);
+	void writeStats(std::ostream& out) const;
+	void attachWormhole(const uint64_t channels, const uint64_t depth,
+		const long arbitration);
+	void reportWormhole(const unsigned long channel) const;
 };
 #endif
@@ -0,0 +1,784 @@
+#include <ucontext.h>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include "mainwindow.h"
+#include "ControlThread.hpp"
+#include "memorypacket.hpp"
+#include "mux.hpp"
+#include "memory.hpp"
+#include "tile.hpp"
+#include "processor.hpp"
+#include "scheduler.hpp"
+#include "warp.hpp"
+
+using namespace std;
+
+//events are ordered by tick and then by tile - so the answer does not
+//depend on the order the host happens to run the tiles in
+static bool after(const uint64_t& timeA, const unsigned long& tileA,
+	const uint64_t& timeB, const unsigned long& tileB)
+{
+	return timeA > timeB || (timeA == timeB && tileA > tileB);
+}
+
+WarpTile::WarpTile(): fiber(nullptr), processor(nullptr),
+	nextCheckpoint(0), pending(false), target(UINT64_MAX), coastUntil(0),
+	restored(false), inTransaction(false), finished(false), published(0),
+	slice(0)
+{}
+
+TimeWarp::TimeWarp(const unsigned long tileCount, const uint64_t w):
+	tiles(tileCount), shards(WARP_SHARDS), scheduler(nullptr), window(w),
+	gvt(0), horizon(0),
+	nextSeq(0), collections(0), liveTiles(0), eventCount(0),
+	stragglers(0), antiMessages(0), rollbacks(0), ticksAgain(0)
+{}
+
+void TimeWarp::attach(TileFiber *fiber, Processor *proc)
+{
+	WarpTile& tile = tiles[fiber->getOrder()];
+	tile.fiber = fiber;
+	tile.processor = proc;
+	proc->keepUndoLog();
+	liveTiles++;
+}
+
+WarpTile& TimeWarp::tileFor(Processor *proc)
+{
+	return tiles[proc->getTile()->getOrder()];
+}
+
+//buffers are bools inside Muxes - words are eight bytes apart
+unsigned long TimeWarp::bufferShard(const bool *buffer) const
+{
+	return ((uintptr_t)buffer >> 4) % WARP_SHARDS;
+}
+
+unsigned long TimeWarp::wordShard(const uint64_t& word) const
+{
+	return (word / sizeof(uint64_t)) % WARP_SHARDS;
+}
+
+//the caller holds the word's shard
+WarpResource& TimeWarp::wordResource(const uint64_t& word)
+{
+	WarpResource& resource = shards[wordShard(word)].words[word];
+	resource.address = word;
+	return resource;
+}
+
+void TimeWarp::lockTiles()
+{
+	for (auto& tile: tiles) {
+		tile.lock.lock();
+	}
+}
+
+void TimeWarp::unlockTiles()
+{
+	for (auto& tile: tiles) {
+		tile.lock.unlock();
+	}
+}
+
+void TimeWarp::lockAll()
+{
+	for (auto& shard: shards) {
+		shard.lock.lock();
+	}
+	lockTiles();
+}
+
+void TimeWarp::unlockAll()
+{
+	unlockTiles();
+	for (auto& shard: shards) {
+		shard.lock.unlock();
+	}
+}
+
+//a tile re-running after a rollback already has its events up to
+//coastUntil - it must not make them again
+bool TimeWarp::coasting(WarpTile& tile, const uint64_t& now)
+{
+	if (tile.coastUntil == 0) {
+		return false;
+	}
+	if (now < tile.coastUntil) {
+		return true;
+	}
+	tile.coastUntil = 0;
+	return false;
+}
+
+//leave for the checkpoint - a transaction unwinds its packet first
+void TimeWarp::unwind(WarpTile& tile)
+{
+	if (tile.inTransaction) {
+		throw WarpRollback();
+	}
+	TileScheduler::rollbackFiber();
+}
+
+void TimeWarp::tick(Processor *proc)
+{
+	WarpTile& tile = tileFor(proc);
+	if (tile.pending.load()) {
+		unwind(tile);
+	}
+	const uint64_t now = proc->getTicks();
+	const uint64_t floor = gvt.load();
+	const bool sliceOver = (++tile.slice >= WARP_SLICE);
+	if (!sliceOver && (now <= floor || now - floor <= window)) {
+		return;
+	}
+	if (sliceOver) {
+		tile.slice = 0;
+		//checkpoints between transactions keep the undo log short
+		if (!tile.inTransaction) {
+			checkpoint(proc, false);
+			trimUndo(tile, proc);
+		}
+	}
+	tile.published.store(proc->getTicks());
+	TileScheduler::yieldTick();
+	if (tile.pending.load()) {
+		unwind(tile);
+	}
+}
+
+void TimeWarp::checkpoint(Processor *proc, const bool transaction)
+{
+	WarpTile& tile = tileFor(proc);
+	if (tile.pending.load()) {
+		unwind(tile);
+	}
+	tile.lock.lock();
+	tile.checkpoints.emplace_back();
+	WarpCheckpoint& point = tile.checkpoints.back();
+	point.index = tile.nextCheckpoint++;
+	point.start = proc->getTicks();
+	point.transaction = transaction;
+	proc->saveState(point.state);
+	tile.inTransaction = transaction;
+	tile.lock.unlock();
+	TileScheduler::checkpointFiber();
+	//a rollback comes back in here with the stack as it was
+	if (tile.restored) {
+		tile.restored = false;
+		tile.lock.lock();
+		WarpCheckpoint *restoredPoint = &tile.checkpoints.back();
+		tile.lock.unlock();
+		proc->restoreState(restoredPoint->state);
+	}
+}
+
+//the oldest checkpoint we keep is as far back as we can rewind
+void TimeWarp::trimUndo(WarpTile& tile, Processor *proc)
+{
+	tile.lock.lock();
+	const uint64_t mark = tile.checkpoints.front().state.undoMark;
+	tile.lock.unlock();
+	proc->forgetUndoBefore(mark);
+}
+
+void TimeWarp::endTransaction(Processor *proc)
+{
+	WarpTile& tile = tileFor(proc);
+	unique_lock<mutex> lck(tile.lock);
+	tile.inTransaction = false;
+}
+
+//the transaction has unwound - go back to the checkpoint
+void TimeWarp::rollback(Processor *proc)
+{
+	WarpTile& tile = tileFor(proc);
+	tile.lock.lock();
+	tile.inTransaction = false;
+	tile.lock.unlock();
+	TileScheduler::rollbackFiber();
+}
+
+//full or empty as the tile should see it at this tick
+bool TimeWarp::observe(const bool *buffer, Processor *proc)
+{
+	const unsigned long order = proc->getTile()->getOrder();
+	WarpTile& tile = tiles[order];
+	const uint64_t now = proc->getTicks();
+	WarpShard& shard = shards[bufferShard(buffer)];
+	unique_lock<mutex> shardLck(shard.lock);
+	unique_lock<mutex> tileLck(tile.lock);
+	//about to unwind - call it full and stay out of trouble
+	if (tile.pending.load()) {
+		return true;
+	}
+	WarpResource& resource = shard.buffers[buffer];
+	const bool full = stateAt(resource, now, order);
+	if (!coasting(tile, now)) {
+		record(tile, resource, WARP_OBSERVE, now, order, 0);
+	}
+	return full;
+}
+
+void TimeWarp::modify(const bool *buffer, Processor *proc, const bool full)
+{
+	const unsigned long order = proc->getTile()->getOrder();
+	WarpTile& tile = tiles[order];
+	const uint64_t now = proc->getTicks();
+	const WarpEventKind kind = full ? WARP_CLAIM : WARP_FREE;
+	WarpShard& shard = shards[bufferShard(buffer)];
+	{
+		unique_lock<mutex> shardLck(shard.lock);
+		unique_lock<mutex> tileLck(tile.lock);
+		if (tile.pending.load() || coasting(tile, now)) {
+			return;
+		}
+		WarpResource& resource = shard.buffers[buffer];
+		if (!late(resource, now, order, true)) {
+			record(tile, resource, kind, now, order, 0);
+			prune(resource);
+			return;
+		}
+	}
+	//a straggler - look again with everything held
+	lockAll();
+	if (!tile.pending.load() && !coasting(tile, now)) {
+		WarpResource& resource = shard.buffers[buffer];
+		invalidate(resource, now, order, true);
+		//caught up in our own cascade
+		if (!tile.pending.load()) {
+			record(tile, resource, kind, now, order, 0);
+			prune(resource);
+		}
+	}
+	unlockAll();
+}
+
+uint8_t TimeWarp::readByte(Processor *proc, const uint64_t& address)
+{
+	const unsigned long order = proc->getTile()->getOrder();
+	WarpTile& tile = tiles[order];
+	const uint64_t now = proc->getTicks();
+	const uint64_t word = address & ~(uint64_t)(sizeof(uint64_t) - 1);
+	unique_lock<mutex> shardLck(shards[wordShard(word)].lock);
+	unique_lock<mutex> tileLck(tile.lock);
+	if (tile.pending.load()) {
+		return 0;
+	}
+	WarpResource& resource = wordResource(word);
+	const uint64_t value = valueAt(resource, proc, now, order);
+	if (!coasting(tile, now)) {
+		record(tile, resource, WARP_READ, now, order, 0);
+	}
+	return (value >> ((address - word) * BITS_PER_BYTE)) & 0xFF;
+}
+
+void TimeWarp::writeLong(Processor *proc, const uint64_t& address,
+	const uint64_t& value)
+{
+	const unsigned long order = proc->getTile()->getOrder();
+	WarpTile& tile = tiles[order];
+	const uint64_t now = proc->getTicks();
+	const uint64_t mask = ~(uint64_t)(sizeof(uint64_t) - 1);
+	const uint64_t firstWord = address & mask;
+	const uint64_t lastWord = (address + sizeof(uint64_t) - 1) & mask;
+	//an unaligned write spans two words - lock their shards in order
+	const unsigned long lowShard = min(wordShard(firstWord),
+		wordShard(lastWord));
+	const unsigned long highShard = max(wordShard(firstWord),
+		wordShard(lastWord));
+	{
+		unique_lock<mutex> lowLck(shards[lowShard].lock);
+		unique_lock<mutex> highLck;
+		if (highShard != lowShard) {
+			highLck = unique_lock<mutex>(shards[highShard].lock);
+		}
+		unique_lock<mutex> tileLck(tile.lock);
+		if (tile.pending.load() || coasting(tile, now)) {
+			return;
+		}
+		bool straggler = false;
+		for (uint64_t word = firstWord; word <= lastWord;
+			word += sizeof(uint64_t)) {
+			straggler = straggler ||
+				late(wordResource(word), now, order, false);
+		}
+		if (!straggler) {
+			writeWords(tile, proc, address, value, now, order);
+			return;
+		}
+	}
+	//a straggler - look again with everything held
+	lockAll();
+	if (!tile.pending.load() && !coasting(tile, now)) {
+		for (uint64_t word = firstWord; word <= lastWord &&
+			!tile.pending.load(); word += sizeof(uint64_t)) {
+			invalidate(wordResource(word), now, order, false);
+		}
+		if (!tile.pending.load()) {
+			writeWords(tile, proc, address, value, now, order);
+		}
+	}
+	unlockAll();
+}
+
+//record the write to every word it touches and make it - the caller
+//holds their shards and the tile
+void TimeWarp::writeWords(WarpTile& tile, Processor *proc,
+	const uint64_t& address, const uint64_t& value, const uint64_t& time,
+	const unsigned long& order)
+{
+	const uint64_t mask = ~(uint64_t)(sizeof(uint64_t) - 1);
+	const uint64_t firstWord = address & mask;
+	const uint64_t lastWord = (address + sizeof(uint64_t) - 1) & mask;
+	for (uint64_t word = firstWord; word <= lastWord;
+		word += sizeof(uint64_t)) {
+		record(tile, wordResource(word), WARP_WRITE, time, order,
+			currentWord(proc, word));
+	}
+	proc->getTile()->writeLong(address, value);
+	for (uint64_t word = firstWord; word <= lastWord;
+		word += sizeof(uint64_t)) {
+		prune(wordResource(word));
+	}
+}
+
+//buffer state is the last claim or free ordered before (time, tile)
+bool TimeWarp::stateAt(const WarpResource& resource, const uint64_t& time,
+	const unsigned long& tile) const
+{
+	const WarpEvent *last = nullptr;
+	for (const auto& event: resource.history) {
+		if (event.kind != WARP_CLAIM && event.kind != WARP_FREE) {
+			continue;
+		}
+		if (!after(time, tile, event.time, event.tile)) {
+			continue;
+		}
+		if (last == nullptr || after(event.time, event.tile,
+			last->time, last->tile) || (event.time == last->time &&
+			event.tile == last->tile && event.seq > last->seq)) {
+			last = &event;
+		}
+	}
+	return last && last->kind == WARP_CLAIM;
+}
+
+//the first write at or after (time, tile) overwrote what we should see
+uint64_t TimeWarp::valueAt(const WarpResource& resource, Processor *proc,
+	const uint64_t& time, const unsigned long& tile) const
+{
+	const WarpEvent *first = nullptr;
+	for (const auto& event: resource.history) {
+		if (event.kind != WARP_WRITE) {
+			continue;
+		}
+		if (after(time, tile, event.time, event.tile)) {
+			continue;
+		}
+		if (first == nullptr || event.seq < first->seq) {
+			first = &event;
+		}
+	}
+	if (first) {
+		return first->oldValue;
+	}
+	return currentWord(proc, resource.address);
+}
+
+uint64_t TimeWarp::currentWord(Processor *proc, const uint64_t& word) const
+{
+	uint64_t value = 0;
+	for (uint64_t i = 0; i < sizeof(uint64_t); i++) {
+		value |= (uint64_t)proc->getTile()->readByte(word + i) <<
+			(i * BITS_PER_BYTE);
+	}
+	return value;
+}
+
+void TimeWarp::putWord(Processor *proc, const uint64_t& word,
+	const uint64_t& value) const
+{
+	for (uint64_t i = 0; i < sizeof(uint64_t); i++) {
+		proc->getTile()->writeByte(word + i,
+			(value >> (i * BITS_PER_BYTE)) & 0xFF);
+	}
+}
+
+void TimeWarp::record(WarpTile& tile, WarpResource& resource,
+	const WarpEventKind& kind, const uint64_t& time,
+	const unsigned long& order, const uint64_t& oldValue)
+{
+	const uint64_t current = tile.nextCheckpoint - 1;
+	//polling the same thing tick after tick is one long event
+	if (kind == WARP_OBSERVE || kind == WARP_READ) {
+		long looked = 0;
+		for (auto ref = tile.events.rbegin();
+			ref != tile.events.rend() && looked < 4; ref++, looked++) {
+			if (ref->resource != &resource || ref->modifies ||
+				ref->checkpoint != current ||
+				ref->until + 1 < time) {
+				continue;
+			}
+			for (auto& event: resource.history) {
+				if (event.seq == ref->seq) {
+					event.until = time;
+				}
+			}
+			ref->until = time;
+			return;
+		}
+	}
+	WarpEvent event;
+	event.seq = nextSeq++;
+	event.time = time;
+	event.until = time;
+	event.tile = order;
+	event.checkpoint = current;
+	event.kind = kind;
+	event.oldValue = oldValue;
+	resource.history.push_back(event);
+	WarpRef ref;
+	ref.resource = &resource;
+	ref.seq = event.seq;
+	ref.time = time;
+	ref.until = time;
+	ref.checkpoint = current;
+	ref.modifies = event.modifies();
+	tile.events.push_back(ref);
+	eventCount++;
+}
+
+//other tiles' events on resource ordered after (time, tile) - and the
+//first tick of each that a change at (time, tile) makes wrong - bounded
+//when the next change to a buffer hides ours from what comes after it
+void TimeWarp::conflicts(const WarpResource& resource, const uint64_t& time,
+	const unsigned long& tile, map<unsigned long, uint64_t>& victims,
+	const bool bounded) const
+{
+	const WarpEvent *next = nullptr;
+	if (bounded) {
+		for (const auto& event: resource.history) {
+			if (event.modifies() &&
+				after(event.time, event.tile, time, tile) &&
+				(next == nullptr || after(next->time, next->tile,
+				event.time, event.tile))) {
+				next = &event;
+			}
+		}
+	}
+	for (const auto& event: resource.history) {
+		if (event.tile == tile ||
+			!after(event.until, event.tile, time, tile)) {
+			continue;
+		}
+		const uint64_t from = max(event.time,
+			event.tile > tile ? time : time + 1);
+		if (next && after(from, event.tile, next->time, next->tile)) {
+			continue;
+		}
+		auto known = victims.find(event.tile);
+		if (known == victims.end() || from < known->second) {
+			victims[event.tile] = from;
+		}
+	}
+}
+
+//would a change at (time, tile) send anybody back
+bool TimeWarp::late(const WarpResource& resource, const uint64_t& time,
+	const unsigned long& tile, const bool bounded) const
+{
+	map<unsigned long, uint64_t> victims;
+	conflicts(resource, time, tile, victims, bounded);
+	return !victims.empty();
+}
+
+//a change at (time, tile) arrived late - cancel every event it makes
+//wrong, and every event those cancellations make wrong, and send the
+//tiles that made them back to a checkpoint
+void TimeWarp::invalidate(WarpResource& resource, const uint64_t& time,
+	const unsigned long& tile, const bool bounded)
+{
+	map<unsigned long, uint64_t> victims;
+	conflicts(resource, time, tile, victims, bounded);
+	if (victims.empty()) {
+		return;
+	}
+	stragglers++;
+	map<unsigned long, uint64_t> cancelFrom;
+	deque<unsigned long> work;
+	for (const auto& victim: victims) {
+		work.push_back(victim.first);
+	}
+	while (!work.empty()) {
+		const unsigned long victim = work.front();
+		work.pop_front();
+		const uint64_t from = victims[victim];
+		auto done = cancelFrom.find(victim);
+		if (done != cancelFrom.end() && done->second <= from) {
+			continue;
+		}
+		cancelFrom[victim] = from;
+		for (const auto& ref: tiles[victim].events) {
+			if (!ref.modifies || ref.until < from) {
+				continue;
+			}
+			map<unsigned long, uint64_t> more;
+			conflicts(*ref.resource, ref.time, victim, more);
+			for (const auto& next: more) {
+				auto known = victims.find(next.first);
+				if (known == victims.end() ||
+					next.second < known->second) {
+					victims[next.first] = next.second;
+					work.push_back(next.first);
+				}
+			}
+		}
+	}
+
+	//mark the victims before their events go
+	vector<tuple<uint64_t, WarpResource *, uint64_t, unsigned long>>
+		cancelled;
+	for (const auto& victim: cancelFrom) {
+		WarpTile& hit = tiles[victim.first];
+		uint64_t earliest = UINT64_MAX;
+		bool pastCoast = false;
+		for (const auto& ref: hit.events) {
+			if (hit.coastUntil && ref.time >= hit.coastUntil) {
+				pastCoast = true;
+			}
+			if (ref.until >= victim.second) {
+				earliest = min(earliest, ref.checkpoint);
+				cancelled.push_back(make_tuple(ref.seq, ref.resource,
+					victim.second, victim.first));
+			}
+		}
+		if (earliest == UINT64_MAX) {
+			continue;
+		}
+		//still coasting - the events between coastUntil and here
+		//were never made again
+		if (hit.coastUntil == 0 || pastCoast) {
+			hit.coastUntil = victim.second;
+		} else {
+			hit.coastUntil = min(hit.coastUntil, victim.second);
+		}
+		//not yet back at that checkpoint - coasting covers it
+		if (earliest >= hit.nextCheckpoint) {
+			continue;
+		}
+		hit.target = min(hit.target, earliest);
+		if (!hit.pending.load()) {
+			hit.pending.store(true);
+			if (hit.finished) {
+				hit.finished = false;
+				liveTiles++;
+				scheduler->revive(hit.fiber);
+			}
+		}
+	}
+
+	//newest first - so each write puts back what it overwrote
+	sort(cancelled.rbegin(), cancelled.rend());
+	for (const auto& cancel: cancelled) {
+		WarpResource& cancelling = *get<1>(cancel);
+		const uint64_t from = get<2>(cancel);
+		for (auto event = cancelling.history.begin();
+			event != cancelling.history.end(); event++) {
+			if (event->seq != get<0>(cancel)) {
+				continue;
+			}
+			if (event->time < from) {
+				event->until = from - 1;
+			} else {
+				if (event->kind == WARP_WRITE) {
+					putWord(tiles[get<3>(cancel)].processor,
+						cancelling.address, event->oldValue);
+				}
+				cancelling.history.erase(event);
+				antiMessages++;
+			}
+			break;
+		}
+	}
+	for (const auto& victim: cancelFrom) {
+		vector<WarpRef>& refs = tiles[victim.first].events;
+		refs.erase(remove_if(refs.begin(), refs.end(),
+			[&victim](const WarpRef& ref) {
+				return ref.time >= victim.second; }),
+			refs.end());
+		for (auto& ref: refs) {
+			if (ref.until >= victim.second) {
+				ref.until = victim.second - 1;
+			}
+		}
+	}
+}
+
+//nothing can now arrive before gvt, and nobody can rewind before the
+//horizon - so only the state at the horizon matters
+void TimeWarp::prune(WarpResource& resource)
+{
+	const uint64_t floor = gvt.load();
+	const uint64_t settled = horizon.load();
+	const WarpEvent *base = nullptr;
+	for (const auto& event: resource.history) {
+		if ((event.kind == WARP_CLAIM || event.kind == WARP_FREE) &&
+			event.time < settled && (base == nullptr ||
+			after(event.time, event.tile, base->time, base->tile) ||
+			(event.time == base->time && event.tile == base->tile &&
+			event.seq > base->seq))) {
+			base = &event;
+		}
+	}
+	const uint64_t baseSeq = base ? base->seq : UINT64_MAX;
+	resource.history.erase(remove_if(resource.history.begin(),
+		resource.history.end(), [floor, settled, baseSeq]
+		(const WarpEvent& event) {
+			if (event.kind == WARP_OBSERVE ||
+				event.kind == WARP_READ) {
+				return event.until < floor;
+			}
+			return event.time < settled && event.seq != baseSeq;
+		}), resource.history.end());
+}
+
+//a shard at a time - the tiles run on meanwhile
+void TimeWarp::sweep()
+{
+	for (auto& shard: shards) {
+		unique_lock<mutex> lck(shard.lock);
+		for (auto& buffer: shard.buffers) {
+			prune(buffer.second);
+		}
+		for (auto word = shard.words.begin(); word != shard.words.end();) {
+			prune(word->second);
+			if (word->second.history.empty()) {
+				word = shard.words.erase(word);
+			} else {
+				word++;
+			}
+		}
+	}
+}
+
+//copy the stack of a fiber that has just checkpointed
+void TimeWarp::saveStack(TileFiber *fiber)
+{
+	WarpTile& tile = tiles[fiber->getOrder()];
+	unique_lock<mutex> lck(tile.lock);
+	WarpCheckpoint& point = tile.checkpoints.back();
+	fiber->saveStack(point.stack, point.stackOffset, point.context);
+}
+
+//put the fiber back as it was at its target checkpoint
+bool TimeWarp::restore(TileFiber *fiber)
+{
+	WarpTile& tile = tiles[fiber->getOrder()];
+	unique_lock<mutex> lck(tile.lock);
+	if (!tile.pending.load()) {
+		return false;
+	}
+	while (!tile.checkpoints.empty() &&
+		tile.checkpoints.back().index > tile.target) {
+		tile.checkpoints.pop_back();
+	}
+	if (tile.checkpoints.empty() ||
+		tile.checkpoints.back().index != tile.target) {
+		cerr << "Time Warp lost checkpoint " << tile.target <<
+			" of tile " << fiber->getOrder() << endl;
+		throw "Time Warp lost a checkpoint\n";
+	}
+	WarpCheckpoint& point = tile.checkpoints.back();
+	ticksAgain += tile.processor->getTicks() - point.start;
+	fiber->loadStack(point.stack, point.stackOffset, point.context);
+	tile.nextCheckpoint = point.index + 1;
+	tile.target = UINT64_MAX;
+	tile.restored = true;
+	tile.inTransaction = point.transaction;
+	tile.slice = 0;
+	tile.published.store(point.start);
+	tile.pending.store(false);
+	rollbacks++;
+	return true;
+}
+
+//false if a straggler has already sent the tile back
+bool TimeWarp::finish(TileFiber *fiber)
+{
+	WarpTile& tile = tiles[fiber->getOrder()];
+	unique_lock<mutex> lck(tile.lock);
+	if (tile.pending.load()) {
+		return false;
+	}
+	tile.finished = true;
+	liveTiles--;
+	return true;
+}
+
+//global virtual time is the earliest tick any tile could still make an
+//event at - everything before it is settled
+void TimeWarp::collect()
+{
+	unique_lock<mutex> collecting(collectLock, try_to_lock);
+	if (!collecting.owns_lock()) {
+		return;
+	}
+	lockTiles();
+	uint64_t lowest = UINT64_MAX;
+	for (auto& tile: tiles) {
+		if (tile.fiber == nullptr || tile.finished) {
+			continue;
+		}
+		uint64_t floor = tile.published.load();
+		if (tile.pending.load()) {
+			for (const auto& point: tile.checkpoints) {
+				if (point.index == tile.target) {
+					floor = min(floor, point.start);
+				}
+			}
+		}
+		lowest = min(lowest, max(floor, tile.coastUntil));
+	}
+	if (lowest == UINT64_MAX || lowest <= gvt.load()) {
+		unlockTiles();
+		return;
+	}
+	gvt.store(lowest);
+	//keep the last checkpoint before gvt and everything since - one
+	//that starts at gvt can still have events at gvt before it
+	uint64_t oldest = lowest;
+	for (auto& tile: tiles) {
+		while (tile.checkpoints.size() > 1 &&
+			tile.checkpoints[1].start < lowest) {
+			tile.checkpoints.pop_front();
+		}
+		tile.events.erase(remove_if(tile.events.begin(),
+			tile.events.end(), [lowest](const WarpRef& ref) {
+				return ref.until < lowest; }), tile.events.end());
+		if (!tile.checkpoints.empty()) {
+			oldest = min(oldest, tile.checkpoints.front().start);
+		}
+	}
+	horizon.store(oldest);
+	unlockTiles();
+	if (++collections % WARP_SWEEP == 0) {
+		sweep();
+	}
+}
+
+void TimeWarp::report() const
+{
+	cout << "Time Warp: " << eventCount.load() << " events, " << stragglers <<
+		" stragglers, " << antiMessages << " anti-messages" << endl;
+	cout << "Time Warp: " << rollbacks.load() << " rollbacks, " <<
+		ticksAgain.load() << " tile ticks run again, GVT " << gvt.load() <<
+		endl;
+}
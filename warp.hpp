@@ -0,0 +1,186 @@
+//Time Warp - tiles run ahead of each other optimistically, and a tile
+//that acted on state another tile later changed in its past rolls
+//back to a checkpoint and runs again
+#include <ucontext.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#ifndef _WARP_CLASS_
+#define _WARP_CLASS_
+
+//ticks a tile runs before it checkpoints and hands back to its worker
+static const uint64_t WARP_SLICE = 1024;
+//collections between sweeps of every event history
+static const uint64_t WARP_SWEEP = 256;
+//Mux buffers and global words are spread over this many locks
+static const uint64_t WARP_SHARDS = 64;
+
+class Processor;
+class TileFiber;
+class TileScheduler;
+
+//thrown in a tile to unwind a Mux transaction that is being rolled back
+class WarpRollback {};
+
+enum WarpEventKind { WARP_OBSERVE, WARP_CLAIM, WARP_FREE,
+	WARP_READ, WARP_WRITE };
+
+//something a tile did to a Mux buffer or a global word - repeated
+//observations by one tile are one event running from time to until
+class WarpEvent {
+public:
+	uint64_t seq;
+	uint64_t time;
+	uint64_t until;
+	unsigned long tile;
+	uint64_t checkpoint;
+	WarpEventKind kind;
+	uint64_t oldValue;
+	bool modifies() const { return kind == WARP_CLAIM ||
+		kind == WARP_FREE || kind == WARP_WRITE; }
+};
+
+class WarpResource {
+public:
+	uint64_t address;
+	std::vector<WarpEvent> history;
+};
+
+//the resources whose address hashes here, and the lock on their
+//histories
+class WarpShard {
+public:
+	std::mutex lock;
+	std::map<const bool *, WarpResource> buffers;
+	std::map<uint64_t, WarpResource> words;
+};
+
+//the same event as seen from the tile that made it
+class WarpRef {
+public:
+	WarpResource *resource;
+	uint64_t seq;
+	uint64_t time;
+	uint64_t until;
+	uint64_t checkpoint;
+	bool modifies;
+};
+
+class WarpCheckpoint {
+public:
+	uint64_t index;
+	uint64_t start;
+	bool transaction;
+	ProcessorState state;
+	std::vector<char> stack;
+	uint64_t stackOffset;
+	ucontext_t context;
+};
+
+//a tile's own state - under its lock, taken after any shard's
+class WarpTile {
+public:
+	std::mutex lock;
+	TileFiber *fiber;
+	Processor *processor;
+	std::deque<WarpCheckpoint> checkpoints;
+	uint64_t nextCheckpoint;
+	std::vector<WarpRef> events;
+	//set when a straggler invalidated us - restore to target
+	std::atomic<bool> pending;
+	uint64_t target;
+	//events before this tick survived the rollback - don't repeat them
+	uint64_t coastUntil;
+	bool restored;
+	bool inTransaction;
+	bool finished;
+	std::atomic<uint64_t> published;
+	uint64_t slice;
+	WarpTile();
+};
+
+//A tile touching a buffer or a word locks that resource's shard and
+//then itself. A straggler's cascade can reach any tile and resource, so
+//it takes every shard and then every tile; collection takes every tile.
+class TimeWarp {
+private:
+	std::vector<WarpTile> tiles;
+	std::vector<WarpShard> shards;
+	//one worker collects at a time - the others go on running tiles
+	std::mutex collectLock;
+	TileScheduler *scheduler;
+	//how far a tile may run ahead of global virtual time
+	const uint64_t window;
+	std::atomic<uint64_t> gvt;
+	std::atomic<uint64_t> horizon;
+	std::atomic<uint64_t> nextSeq;
+	uint64_t collections;
+	std::atomic<long> liveTiles;
+	std::atomic<uint64_t> eventCount;
+	uint64_t stragglers;
+	uint64_t antiMessages;
+	std::atomic<uint64_t> rollbacks;
+	std::atomic<uint64_t> ticksAgain;
+	WarpTile& tileFor(Processor *proc);
+	unsigned long bufferShard(const bool *buffer) const;
+	unsigned long wordShard(const uint64_t& word) const;
+	WarpResource& wordResource(const uint64_t& word);
+	void lockTiles();
+	void unlockTiles();
+	void lockAll();
+	void unlockAll();
+	bool coasting(WarpTile& tile, const uint64_t& now);
+	void unwind(WarpTile& tile);
+	void checkpoint(Processor *proc, const bool transaction);
+	void trimUndo(WarpTile& tile, Processor *proc);
+	bool stateAt(const WarpResource& resource, const uint64_t& time,
+		const unsigned long& tile) const;
+	uint64_t valueAt(const WarpResource& resource, Processor *proc,
+		const uint64_t& time, const unsigned long& tile) const;
+	uint64_t currentWord(Processor *proc, const uint64_t& word) const;
+	void putWord(Processor *proc, const uint64_t& word,
+		const uint64_t& value) const;
+	void record(WarpTile& tile, WarpResource& resource,
+		const WarpEventKind& kind, const uint64_t& time,
+		const unsigned long& order, const uint64_t& oldValue);
+	void conflicts(const WarpResource& resource, const uint64_t& time,
+		const unsigned long& tile,
+		std::map<unsigned long, uint64_t>& victims,
+		const bool bounded = false) const;
+	bool late(const WarpResource& resource, const uint64_t& time,
+		const unsigned long& tile, const bool bounded) const;
+	void invalidate(WarpResource& resource, const uint64_t& time,
+		const unsigned long& tile, const bool bounded);
+	void writeWords(WarpTile& tile, Processor *proc,
+		const uint64_t& address, const uint64_t& value,
+		const uint64_t& time, const unsigned long& order);
+	void prune(WarpResource& resource);
+	void sweep();
+
+public:
+	TimeWarp(const unsigned long tileCount, const uint64_t w);
+	void attachScheduler(TileScheduler *sched) { scheduler = sched; }
+	void attach(TileFiber *fiber, Processor *proc);
+	//called from inside a tile
+	void tick(Processor *proc);
+	void checkpoint(Processor *proc) { checkpoint(proc, true); }
+	void endTransaction(Processor *proc);
+	void rollback(Processor *proc);
+	bool observe(const bool *buffer, Processor *proc);
+	void modify(const bool *buffer, Processor *proc, const bool full);
+	uint8_t readByte(Processor *proc, const uint64_t& address);
+	void writeLong(Processor *proc, const uint64_t& address,
+		const uint64_t& value);
+	//called from the workers
+	void saveStack(TileFiber *fiber);
+	bool restore(TileFiber *fiber);
+	bool finish(TileFiber *fiber);
+	void collect();
+	bool done() const { return liveTiles.load() == 0; }
+	void report() const;
+};
+
+#endif
@@ -0,0 +1,384 @@
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include <condition_variable>
+#include "mainwindow.h"
+#include "ControlThread.hpp"
+#include "memorypacket.hpp"
+#include "mux.hpp"
+#include "memory.hpp"
+#include "tree.hpp"
+#include "tile.hpp"
+#include "processor.hpp"
+#include "arbiter.hpp"
+#include "wormhole.hpp"
+
+using namespace std;
+
+//a router for every Mux each way, wired as the tree is - node i's
+//children are 2i + 1 and 2i + 2, the leaves the last tiles / 2
+Wormhole::Wormhole(const uint64_t vcs, const uint64_t flits, const long l,
+	const uint64_t tiles, const RouteStep *paths, const long arbitration):
+	channels(vcs), depth(flits), levels(l), routes(paths),
+	up(tiles - 1), down(tiles - 1), sources(tiles), requests(0),
+	answers(0), upTicks(0), downTicks(0), hops(0), channelWaits(0),
+	creditWaits(0), switchWaits(0)
+{
+	const uint64_t nodeCount = tiles - 1;
+	const uint64_t firstLeaf = tiles / 2 - 1;
+	for (uint64_t i = 0; i < nodeCount; i++) {
+		long depthOf = 0;
+		for (uint64_t n = i + 1; n > 1; n >>= 1) {
+			depthOf++;
+		}
+		up[i].node = i;
+		up[i].level = levels - depthOf;
+		up[i].inputs.resize(2);
+		up[i].outputs.resize(1);
+		up[i].arbiter = Arbiter::create(arbitration,
+			1UL << up[i].level, 1UL << up[i].level);
+		down[i].node = i;
+		down[i].level = up[i].level;
+		down[i].down = true;
+		down[i].inputs.resize(1);
+		down[i].outputs.resize(2);
+		for (auto& input: up[i].inputs) {
+			input.channels.resize(channels);
+		}
+		down[i].inputs[0].channels.resize(channels);
+	}
+	//the root's output up is DDR, the leaves' outputs down are tiles
+	for (uint64_t i = 1; i < nodeCount; i++) {
+		connect(up[i].outputs[0], up[(i - 1) / 2], i % 2 == 1 ? 0 : 1);
+	}
+	for (uint64_t i = 0; i < firstLeaf; i++) {
+		connect(down[i].outputs[0], down[2 * i + 1], 0);
+		connect(down[i].outputs[1], down[2 * i + 2], 0);
+	}
+	for (uint64_t i = 0; i < tiles; i++) {
+		const RouteStep *step = routes + i * (levels + 1);
+		sources[i].inputs.resize(1);
+		sources[i].inputs[0].channels.resize(1);
+		sources[i].outputs.resize(1);
+		connect(sources[i].outputs[0], up[step[0].node],
+			step[0].left ? 0 : 1);
+	}
+	ddrSource.down = true;
+	ddrSource.inputs.resize(1);
+	ddrSource.inputs[0].channels.resize(1);
+	ddrSource.outputs.resize(1);
+	connect(ddrSource.outputs[0], down[0], 0);
+}
+
+Wormhole::~Wormhole()
+{
+	for (auto& router: up) {
+		delete router.arbiter;
+	}
+}
+
+//every virtual channel at the far end starts out empty
+void Wormhole::connect(OutputPort& output, Router& next, const uint64_t port)
+{
+	output.next = &next;
+	output.nextPort = port;
+	output.credits.assign(next.inputs[port].channels.size(), depth);
+	output.held.assign(next.inputs[port].channels.size(), false);
+	next.inputs[port].upstream = &output;
+}
+
+//cut the message into packets of at most PACKET_FLITS, each with a head
+//of its own, behind whatever the source has still to send
+void Wormhole::queue(Router& source, MemoryPacket *packet,
+	const uint64_t& bytes, const uint64_t& tick)
+{
+	deque<Flit>& flits = source.inputs[0].channels[0].flits;
+	uint64_t data = (bytes + FLIT_BYTES - 1) / FLIT_BYTES;
+	uint64_t total = 0;
+	do {
+		const uint64_t body = min(data, PACKET_FLITS - 1);
+		data -= body;
+		for (uint64_t i = 0; i <= body; i++) {
+			Flit flit;
+			flit.packet = packet;
+			flit.ready = tick;
+			flit.head = (i == 0);
+			flit.tail = (i == body);
+			flits.push_back(flit);
+		}
+		total += body + 1;
+	} while (data > 0);
+	source.buffered += total;
+	Message message;
+	message.flits = total;
+	message.sent = tick;
+	messages[packet] = message;
+}
+
+//a tile's request - read by the next commit. A write back carries its
+//data up, a read just the address
+void Wormhole::post(MemoryPacket *packet)
+{
+	unique_lock<mutex> lck(postLock);
+	posted.push_back(packet);
+}
+
+//DDR's answer - the data for a read, only a head for a write back
+void Wormhole::respond(MemoryPacket *packet, const uint64_t& tick)
+{
+	queue(ddrSource, packet,
+		packet->getDestination() ? packet->getRequestSize() : 0, tick);
+}
+
+//the way a head goes - only the routers coming down have a choice
+long Wormhole::outputOf(const Router& router, const MemoryPacket *packet)
+	const
+{
+	if (router.outputs.size() == 1) {
+		return 0;
+	}
+	const RouteStep *step = routes +
+		packet->getProcessor()->getTile()->getOrder() * (levels + 1);
+	if (router.level == 0) {
+		return step[0].left ? 0 : 1;
+	}
+	return step[router.level - 1].node == 2 * router.node + 1 ? 0 : 1;
+}
+
+//a head at the front of its buffer takes the lowest free virtual
+//channel on its way out, and holds it until its tail has gone through
+void Wormhole::allocate(Router& router, const uint64_t& tick)
+{
+	for (auto& input: router.inputs) {
+		for (auto& channel: input.channels) {
+			if (channel.flits.empty() || channel.output >= 0 ||
+				channel.flits.front().ready > tick) {
+				continue;
+			}
+			const long output = outputOf(router,
+				channel.flits.front().packet);
+			OutputPort& port = router.outputs[output];
+			if (port.next == nullptr) {
+				channel.output = output;
+				channel.outputChannel = 0;
+				continue;
+			}
+			uint64_t free = 0;
+			while (free < port.held.size() && port.held[free]) {
+				free++;
+			}
+			if (free == port.held.size()) {
+				channelWaits++;
+				continue;
+			}
+			port.held[free] = true;
+			channel.output = output;
+			channel.outputChannel = free;
+		}
+	}
+}
+
+bool Wormhole::movable(const Router& router, const VirtualChannel& channel,
+	const long output, const uint64_t& tick) const
+{
+	if (channel.flits.empty() || channel.output != output ||
+		channel.flits.front().ready > tick) {
+		return false;
+	}
+	const OutputPort& port = router.outputs[output];
+	return port.next == nullptr ||
+		port.credits[channel.outputChannel] > 0;
+}
+
+//the flit at the front of the input's turn goes over the link - its
+//buffer's credit goes back upstream, and a tail lets go of the
+//virtual channel it held
+void Wormhole::traverse(Router& router, const uint64_t port,
+	const uint64_t& tick, vector<MemoryPacket *>& atRoot)
+{
+	InputPort& input = router.inputs[port];
+	VirtualChannel& channel = input.channels[input.turn];
+	OutputPort& output = router.outputs[channel.output];
+	const uint64_t next = channel.outputChannel;
+	Flit flit = channel.flits.front();
+	channel.flits.pop_front();
+	router.buffered--;
+	if (input.upstream) {
+		returned.push_back(pair<OutputPort *, uint64_t>(
+			input.upstream, input.turn));
+	}
+	if (flit.tail) {
+		channel.output = -1;
+		if (output.next) {
+			output.held[next] = false;
+		}
+	}
+	input.turn = (input.turn + 1) % input.channels.size();
+	if (output.next == nullptr) {
+		arrive(router, flit.packet, tick, atRoot);
+		return;
+	}
+	flit.ready = tick + 1;
+	output.credits[next]--;
+	output.next->inputs[output.nextPort].channels[next].flits.push_back(
+		flit);
+	output.next->buffered++;
+	hops++;
+}
+
+//the last flit of a message is in - a request goes on to DDR, an answer
+//is home
+void Wormhole::arrive(const Router& router, MemoryPacket *packet,
+	const uint64_t& tick, vector<MemoryPacket *>& atRoot)
+{
+	auto message = messages.find(packet);
+	if (--message->second.flits > 0) {
+		return;
+	}
+	const uint64_t sent = message->second.sent;
+	messages.erase(message);
+	if (!router.down) {
+		requests++;
+		upTicks += tick - sent;
+		atRoot.push_back(packet);
+		return;
+	}
+	answers++;
+	downTicks += tick - sent;
+	if (packet->isSplit()) {
+		packet->complete(tick);
+		packet->getProcessor()->getTile()->getBarrier()->
+			packetLanded();
+	} else {
+		packet->serve();
+	}
+}
+
+//a tick of one router - each output takes a flit from one input, each
+//input gives one flit. Going up, the arbiter settles it when both
+//inputs have one ready
+void Wormhole::step(Router& router, const uint64_t& tick,
+	vector<MemoryPacket *>& atRoot)
+{
+	allocate(router, tick);
+	bool used[2] = {false, false};
+	for (uint64_t output = 0; output < router.outputs.size(); output++) {
+		long chosen[2] = {-1, -1};
+		for (uint64_t port = 0; port < router.inputs.size(); port++) {
+			if (used[port]) {
+				continue;
+			}
+			InputPort& input = router.inputs[port];
+			const uint64_t count = input.channels.size();
+			for (uint64_t i = 0; i < count; i++) {
+				const uint64_t c = (input.turn + i) % count;
+				if (movable(router, input.channels[c], output,
+					tick)) {
+					chosen[port] = c;
+					break;
+				}
+			}
+		}
+		uint64_t winner = chosen[0] >= 0 ? 0 : 1;
+		if (chosen[winner] < 0) {
+			continue;
+		}
+		if (chosen[0] >= 0 && chosen[1] >= 0) {
+			const MemoryPacket *left = router.inputs[0].channels[
+				chosen[0]].flits.front().packet;
+			const MemoryPacket *right = router.inputs[1].channels[
+				chosen[1]].flits.front().packet;
+			winner = router.arbiter->leftFirst(left->getIssued(),
+				right->getIssued()) ? 0 : 1;
+		}
+		if (router.arbiter) {
+			router.arbiter->granted(winner == 0);
+		}
+		router.inputs[winner].turn = chosen[winner];
+		used[winner] = true;
+		traverse(router, winner, tick, atRoot);
+	}
+	//what is left at the front of a buffer and ready waited a tick -
+	//bar an input that sent, whose next flit could not have gone
+	for (uint64_t port = 0; port < router.inputs.size(); port++) {
+		if (used[port]) {
+			continue;
+		}
+		for (const auto& channel: router.inputs[port].channels) {
+			if (channel.flits.empty() || channel.output < 0 ||
+				channel.flits.front().ready > tick) {
+				continue;
+			}
+			const OutputPort& output =
+				router.outputs[channel.output];
+			if (output.next &&
+				output.credits[channel.outputChannel] == 0) {
+				creditWaits++;
+			} else {
+				switchWaits++;
+			}
+		}
+	}
+}
+
+//called from the tree's commit, no tile running. The tick's requests
+//join their tiles' queues in tile order, every router with a flit in
+//it takes its turn, then the credits freed get back upstream
+void Wormhole::tick(const uint64_t& tick, vector<MemoryPacket *>& atRoot)
+{
+	{
+		unique_lock<mutex> lck(postLock);
+		stable_sort(posted.begin(), posted.end(),
+			[](const MemoryPacket *a, const MemoryPacket *b) {
+				return a->getProcessor()->getTile()->getOrder() <
+					b->getProcessor()->getTile()->getOrder();
+			});
+		for (auto packet: posted) {
+			queue(sources[packet->getProcessor()->getTile()->
+				getOrder()], packet, packet->getDestination() ?
+				0 : packet->getRequestSize(), tick);
+		}
+		posted.clear();
+	}
+	for (auto& source: sources) {
+		if (source.buffered) {
+			step(source, tick, atRoot);
+		}
+	}
+	for (auto& router: up) {
+		if (router.buffered) {
+			step(router, tick, atRoot);
+		}
+	}
+	if (ddrSource.buffered) {
+		step(ddrSource, tick, atRoot);
+	}
+	for (auto& router: down) {
+		if (router.buffered) {
+			step(router, tick, atRoot);
+		}
+	}
+	for (const auto& credit: returned) {
+		credit.first->credits[credit.second]++;
+	}
+	returned.clear();
+}
+
+void Wormhole::report(const unsigned long channel) const
+{
+	if (requests == 0) {
+		return;
+	}
+	cout << "Wormhole, channel " << channel << ", " << channels;
+	cout << " virtual channels of " << depth << " flits: " << requests;
+	cout << " requests, mean " << (double)upTicks / requests;
+	cout << " ticks up and " << (answers ? (double)downTicks / answers :
+		0.0) << " down, " << hops << " flit hops" << endl;
+	cout << "Wormhole, channel " << channel << ": flit ticks waiting on";
+	cout << " a virtual channel " << channelWaits << ", on credit ";
+	cout << creditWaits << ", on the switch " << switchWaits << endl;
+}
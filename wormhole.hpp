@@ -0,0 +1,146 @@
+//flit level wormhole routing through a Mux tree
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+#ifndef _WORMHOLE_CLASS_
+#define _WORMHOLE_CLASS_
+
+//a 128 bit flit, and at most five to a packet - a head and four of data,
+//so a cache line goes as one packet and anything longer as several
+static const uint64_t FLIT_BYTES = 16;
+static const uint64_t PACKET_FLITS = 5;
+
+class MemoryPacket;
+class Arbiter;
+class RouteStep;
+class Router;
+
+class Flit {
+public:
+	MemoryPacket *packet;
+	//tick it can leave the buffer it is in - a hop a tick
+	uint64_t ready;
+	bool head;
+	bool tail;
+};
+
+//a virtual channel's buffer at a router's input, and the output and
+//virtual channel the packet at its front holds - a head has to win
+//both before it moves, the rest of its packet follows it
+class VirtualChannel {
+public:
+	std::deque<Flit> flits;
+	long output;
+	uint64_t outputChannel;
+	VirtualChannel(): output(-1), outputChannel(0) {}
+};
+
+//a link out of a router - credits for the space left in each virtual
+//channel at the far end, and which of them a packet holds. With no
+//router at the far end it is a sink, a tile or DDR, and takes a flit
+//every tick
+class OutputPort {
+public:
+	Router *next;
+	uint64_t nextPort;
+	std::vector<uint64_t> credits;
+	std::vector<bool> held;
+	OutputPort(): next(nullptr), nextPort(0) {}
+};
+
+class InputPort {
+public:
+	std::vector<VirtualChannel> channels;
+	//where credits go back to - null for a source's own queue
+	OutputPort *upstream;
+	//virtual channel that gets the first look next tick
+	uint64_t turn;
+	InputPort(): upstream(nullptr), turn(0) {}
+};
+
+//a Mux as a router - two inputs and one output going up, one input and
+//two outputs coming down. The arbiter picks between the two inputs
+//going up as the Mux's does between its buffers
+class Router {
+public:
+	uint64_t node;
+	long level;
+	bool down;
+	std::vector<InputPort> inputs;
+	std::vector<OutputPort> outputs;
+	Arbiter *arbiter;
+	//flits in its input buffers - an empty router is passed over
+	uint64_t buffered;
+	Router(): node(0), level(0), down(false), arbiter(nullptr),
+		buffered(0) {}
+};
+
+//flits of a request or an answer still to get to the far end
+class Message {
+public:
+	uint64_t flits;
+	uint64_t sent;
+};
+
+//Driven by the commits, like the DDR controller. Requests and answers
+//have a network each, so an answer never waits behind a request. Every
+//link carries a flit a tick, and a flit only moves when there is room
+//for it in its virtual channel at the far end - credit based flow
+//control. Tiles post requests to their leaf; the root hands what gets
+//to the top to DDR and posts the answers back down.
+class Wormhole {
+private:
+	const uint64_t channels;
+	const uint64_t depth;
+	const long levels;
+	//the tree's paths, levels + 1 steps a tile
+	const RouteStep *routes;
+	//heap order, like the Muxes
+	std::vector<Router> up;
+	std::vector<Router> down;
+	//each tile's interface to its leaf, and DDR's to the root
+	std::vector<Router> sources;
+	Router ddrSource;
+	std::map<MemoryPacket *, Message> messages;
+	std::mutex postLock;
+	std::vector<MemoryPacket *> posted;
+	//credits freed this tick - back upstream for the next
+	std::vector<std::pair<OutputPort *, uint64_t>> returned;
+	uint64_t requests;
+	uint64_t answers;
+	uint64_t upTicks;
+	uint64_t downTicks;
+	uint64_t hops;
+	//flit ticks a packet could have moved but for a virtual channel,
+	//a credit or the other input
+	uint64_t channelWaits;
+	uint64_t creditWaits;
+	uint64_t switchWaits;
+	void connect(OutputPort& output, Router& next, const uint64_t port);
+	void queue(Router& source, MemoryPacket *packet,
+		const uint64_t& bytes, const uint64_t& tick);
+	long outputOf(const Router& router, const MemoryPacket *packet) const;
+	void allocate(Router& router, const uint64_t& tick);
+	bool movable(const Router& router, const VirtualChannel& channel,
+		const long output, const uint64_t& tick) const;
+	void traverse(Router& router, const uint64_t port,
+		const uint64_t& tick, std::vector<MemoryPacket *>& atRoot);
+	void arrive(const Router& router, MemoryPacket *packet,
+		const uint64_t& tick, std::vector<MemoryPacket *>& atRoot);
+	void step(Router& router, const uint64_t& tick,
+		std::vector<MemoryPacket *>& atRoot);
+
+public:
+	Wormhole(const uint64_t vcs, const uint64_t flits, const long l,
+		const uint64_t tiles, const RouteStep *paths,
+		const long arbitration);
+	~Wormhole();
+	void post(MemoryPacket *packet);
+	void respond(MemoryPacket *packet, const uint64_t& tick);
+	void tick(const uint64_t& tick, std::vector<MemoryPacket *>& atRoot);
+	void report(const unsigned long channel) const;
+};
+
+#endif